@@ -8,21 +8,27 @@
 
 using namespace std;
 
-Application::Application(const char* caption, int width, int height)
+Application::Application(const char* caption, int width, int height, bool headless)
 {
-	this->window = createWindow(caption, width, height);
+	this->window = headless ? NULL : createWindow(caption, width, height);
 
 	// initialize attributes
 	// Warning: DO NOT CREATE STUFF HERE, USE THE INIT 
 	// things create here cannot access opengl
-	int w,h;
-	SDL_GetWindowSize(window,&w,&h);
+	int w = width, h = height;
+	if (window)
+		SDL_GetWindowSize(window,&w,&h);
 
 	this->window_width = w;
 	this->window_height = h;
-	this->keystate = SDL_GetKeyboardState(NULL);
+	memset(this->headless_keystate, 0, SDL_NUM_SCANCODES);
+	this->keystate = headless ? this->headless_keystate : SDL_GetKeyboardState(NULL);
 	memcpy((void*)&(this->current_keystate), this->keystate, SDL_NUM_SCANCODES);
+	this->mouse_state = 0;
+	this->wait_when_idle = true;
+	this->pipelined = false;
 
+	framebuffer.setRowAlignment(Image::BUFFER_ALIGNMENT); //every row starts on a cache line
 	framebuffer.resize(w, h);
 }
 
@@ -109,6 +115,8 @@ void Application::init(void)
 		//Le sumamos a cada posicin inicial la mitad del vector para que no empiece exactamente desde el centro
 		particles[i].x += particles[i].v_x / 2;
 		particles[i].y += particles[i].v_y / 2;
+		particles[i].prev_x = particles[i].x;
+		particles[i].prev_y = particles[i].y;
 
 		//Eleccin de color segn la posicin
 		if (i % 3 == 0) {
@@ -131,6 +139,12 @@ void Application::render( Image& framebuffer )
 	const int height = 150;
 	const int radius = 100;
 
+	// Rotation (the angle changes in update, a frame can run several update steps)
+	if (isKeyPressed(SDL_SCANCODE_RIGHT) || isKeyPressed(SDL_SCANCODE_LEFT))
+	{
+		framebuffer.rotate(waifu, beta);
+	}
+
 	// Clean framebuffer
 	if (wasKeyPressed(SDL_SCANCODE_0)) 
 	{
@@ -197,18 +211,11 @@ void Application::render( Image& framebuffer )
 		const Image* img = waifu;
 
 		// Compute offset
-		const int x_offset = (framebuffer.width - img->width) / 2;
+		const int x_offset = (int(framebuffer.width) - int(img->width)) / 2;
 		const int y_offset = (int(framebuffer.height) - int(img->height)) / 2;
 
-		// Iterate image and fill framebuffer
-		for (unsigned int i = 0; i < img->width; i++) 
-		{
-			for (unsigned int j = 0; j < img->height; j++) 
-			{
-				const Color c = img->getPixelSafe(i, j);
-				framebuffer.setPixelSafe(x_offset + i, y_offset + j, c);
-			}
-		}
+		// Copy the image rows into the framebuffer (clipped to it)
+		framebuffer.blit(img->getView(), x_offset, y_offset);
 	}
 	else if (wasKeyPressed(SDL_SCANCODE_W)) // Gray scale filter
 	{ 
@@ -247,14 +254,20 @@ void Application::render( Image& framebuffer )
 
 	// Particle animation
 	if(particle_keyword){
-		framebuffer.fill(Color::BLACK);
+		// Recorded and drawn by tiles in parallel
+		draw_list.clear();
+		draw_list.fill(Color::BLACK);
+		const double alpha = scheduler.getAlpha();
 		for (int i = 0; i < 400; i++) {
-			for (int a = -particles[i].size; a < particles[i].size; a++) {
-				for (int b = -particles[i].size; b < particles[i].size; b++) {
-					framebuffer.setPixelSafe(particles[i].x + a, particles[i].y + b, particles[i].color);
-				}
-			}
+			// Between the last two update steps
+			const double x = particles[i].prev_x + (particles[i].x - particles[i].prev_x) * alpha;
+			const double y = particles[i].prev_y + (particles[i].y - particles[i].prev_y) * alpha;
+
+			// Square of the offsets [-size, size) around the particle
+			const int first = (int)-particles[i].size, end = (int)ceil(particles[i].size);
+			draw_list.fillRect((int)floor(x) + first, (int)floor(y) + first, end - first, end - first, particles[i].color);
 		}
+		framebuffer.draw(draw_list);
 	}
 
 	// Canvas 
@@ -331,15 +344,13 @@ void Application::render( Image& framebuffer )
 void Application::update(double seconds_elapsed)
 {
 
+	// Rotation angle, the image is rotated once per frame in render
 	if (keystate[SDL_SCANCODE_RIGHT]){
 		beta -= 0.01;
-		framebuffer.rotate(waifu, beta);
-
 	}
 	else if (keystate[SDL_SCANCODE_LEFT]) 
 	{
 		beta += 0.01;
-		framebuffer.rotate(waifu, beta);
 	}
 	else if (keystate[SDL_SCANCODE_D]) {
 		canvas_state = 1;
@@ -368,6 +379,10 @@ void Application::update(double seconds_elapsed)
 				particles[i].color = Color::CYAN;
 			}
 
+			//Posicin antes del paso, render dibuja entre las dos
+			particles[i].prev_x = particles[i].x;
+			particles[i].prev_y = particles[i].y;
+
 			//Movimiento de las partculas
 			particles[i].x = particles[i].x + particles[i].v_x * seconds_elapsed * 2;
 			particles[i].y = particles[i].y + particles[i].v_y * seconds_elapsed * 2;
@@ -376,6 +391,21 @@ void Application::update(double seconds_elapsed)
 
 }
 
+//after update, false when the next frame would be the same until an event arrives
+bool Application::isAnimating()
+{
+	if (particle_keyword || mouse_state || mouse_right_state)
+		return true;
+
+	//held keys keep drawing (rectangles, zoom, rotation...)
+	for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+		if (keystate[i])
+			return true;
+
+	//written by update and not sent to the screen yet
+	return framebuffer.isDirty();
+}
+
 //keyboard press event 
 void Application::onKeyDown( SDL_KeyboardEvent event )
 {
@@ -433,3 +463,10 @@ void Application::start()
 	std::cout << "launching loop..." << std::endl;
 	launchLoop(this);
 }
+
+//when the app starts without a window
+void Application::startHeadless(const HeadlessSettings& settings)
+{
+	std::cout << "launching headless loop..." << std::endl;
+	launchHeadlessLoop(this, settings);
+}
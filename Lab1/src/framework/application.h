@@ -8,12 +8,17 @@
 #include "includes.h"
 #include "framework.h"
 #include "image.h"
+#include "drawlist.h"
+#include "headless.h"
+#include "framescheduler.h"
 
 
 //Particle Struct
 struct Particle {
 	double x;
 	double y;
+	double prev_x; //before the last update step, drawn interpolated to x,y
+	double prev_y;
 	double aux_x;
 	double aux_y;
 	double v_x;
@@ -26,7 +31,7 @@ class Application
 {
 public:
 	
-	//window
+	//window (NULL when headless)
 	SDL_Window* window;
 	float window_width;
 	float window_height;
@@ -52,6 +57,7 @@ public:
 	const Uint8* keystate;
 	Uint8 current_keystate[SDL_NUM_SCANCODES];
 	Uint8 prev_keystate[SDL_NUM_SCANCODES]; //previous before
+	Uint8 headless_keystate[SDL_NUM_SCANCODES]; //what keystate points to when headless, written by the scripted keys
 
 	//Mouse state
 	int mouse_state; //tells which buttons are pressed
@@ -74,13 +80,27 @@ public:
 	//Particles animation keyword
 	int particle_keyword;
 
-	//constructor
-	Application(const char* caption, int width, int height);
+	//Commands of the frame drawn by tiles (kept between frames so its memory is reused)
+	DrawList draw_list;
+
+	//fixed update steps and frame rate of the main loop, render draws the particles with its interpolation factor
+	FrameScheduler scheduler;
+
+	//the main loop sleeps until the next event while the app is idle (see isAnimating)
+	bool wait_when_idle;
+
+	//the main loop renders the next frame on another thread while it shows the last one (see redrawsWholeFrame)
+	bool pipelined;
+
+	//constructor (headless: no window nor OpenGL, see headless.h)
+	Application(const char* caption, int width, int height, bool headless = false);
 
 	//main methods
 	void init( void );
 	void render( Image& framebuffer );
 	void update( double dt );
+	bool isAnimating(); //something changes without new events: particles, held keys or buttons, a framebuffer not shown yet
+	bool redrawsWholeFrame() { return particle_keyword != 0; } //render does not read the last frame, so it can draw into another buffer
 
 	// methods for keyboard
 	inline bool isKeyPressed(const int key_code) { return this->keystate[key_code] != 0; };
@@ -94,7 +114,8 @@ public:
 
 	//other methods to control the app
 	void setWindowSize(int width, int height) {
-		glViewport( 0,0, width, height );
+		if (window)
+			glViewport( 0,0, width, height );
 		this->window_width = width;
 		this->window_height = height;
 		framebuffer.resize(width,height);
@@ -102,12 +123,15 @@ public:
 
 	Vector2 getWindowSize()
 	{
+		if (!window)
+			return Vector2(window_width, window_height);
 		int w,h;
 		SDL_GetWindowSize(window,&w,&h);
 		return Vector2(w,h);
 	}
 
 	void start();
+	void startHeadless(const HeadlessSettings& settings);
 };
 
 
@@ -0,0 +1,287 @@
+#include "blur.h"
+#include <limits>
+
+// Index of the sample i of a line of n pixels, -1 when it is black
+static int edgeIndex(int i, int n, BlurEdge edge)
+{
+	if (i >= 0 && i < n)
+		return i;
+
+	switch (edge)
+	{
+		case EDGE_CLAMP:
+			return i < 0 ? 0 : n - 1;
+		case EDGE_MIRROR:
+		{
+			if (n == 1) return 0;
+			const int period = 2 * (n - 1);
+			i %= period;
+			if (i < 0) i += period;
+			return i < n ? i : period - i;
+		}
+		case EDGE_WRAP:
+			i %= n;
+			return i < 0 ? i + n : i;
+		default:
+			return -1;
+	}
+}
+
+// Blurred value back to the channel (rounded for integer channels)
+template <typename PixelT>
+static inline typename PixelTraits<PixelT>::Channel toChannel(float value)
+{
+	typedef PixelTraits<PixelT> Traits;
+	return Traits::fromFloat(std::numeric_limits<typename Traits::Channel>::is_integer ? value + 0.5f : value);
+}
+
+template <typename PixelT>
+SeparableBlurT<PixelT>::SeparableBlurT()
+{
+	edge = EDGE_CLAMP;
+	setBox(1, 1);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::setBox(unsigned int radius_x, unsigned int radius_y)
+{
+	passes.clear();
+	addBoxPass(false, radius_x);
+	addBoxPass(true, radius_y);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::setGaussian(float sigma_x, float sigma_y)
+{
+	passes.clear();
+	addGaussianPass(false, sigma_x);
+	addGaussianPass(true, sigma_y);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::setFastGaussian(float sigma_x, float sigma_y)
+{
+	passes.clear();
+	addFastGaussianPasses(false, sigma_x);
+	addFastGaussianPasses(true, sigma_y);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::addBoxPass(bool vertical, unsigned int radius)
+{
+	if (radius == 0)
+		return;
+	Pass pass;
+	pass.vertical = vertical;
+	pass.radius = radius;
+	passes.push_back(pass);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::addGaussianPass(bool vertical, float sigma)
+{
+	const unsigned int radius = sigma > 0 ? (unsigned int)ceil(3 * sigma) : 0;
+	if (radius == 0)
+		return;
+
+	Pass pass;
+	pass.vertical = vertical;
+	pass.radius = radius;
+	pass.weights.resize(2 * radius + 1);
+
+	float total = 0;
+	for (int i = -(int)radius; i <= (int)radius; ++i)
+		total += pass.weights[i + radius] = exp(-(i * i) / (2 * sigma * sigma));
+	for (unsigned int i = 0; i < pass.weights.size(); ++i)
+		pass.weights[i] /= total;
+
+	passes.push_back(pass);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::addFastGaussianPasses(bool vertical, float sigma)
+{
+	if (sigma <= 0)
+		return;
+
+	// Sizes of three boxes (odd, the first m ones smaller) whose variances add up to sigma^2
+	const float variance = 12 * sigma * sigma;
+	int lower = (int)floor(sqrt(variance / 3 + 1));
+	if (lower % 2 == 0) lower--;
+	const int upper = lower + 2;
+	const int m = (int)floor((variance - 3 * lower * lower - 12 * lower - 9) / (-4.0f * lower - 4) + 0.5f);
+
+	for (int i = 0; i < 3; ++i)
+		addBoxPass(vertical, ((i < m ? lower : upper) - 1) / 2);
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::apply(const ImageViewT<PixelT>& view)
+{
+	if (passes.empty() || view.isEmpty())
+		return;
+
+	if (scratch.width < view.width || scratch.height < view.height)
+		scratch = ImageT<PixelT>(std::max(scratch.width, view.width), std::max(scratch.height, view.height), ImageT<PixelT>::BUFFER_ALIGNMENT);
+
+	// Every pass reads one buffer and writes the other
+	ImageViewT<PixelT> src = view;
+	ImageViewT<PixelT> dst = scratch.getView(0, 0, view.width, view.height);
+	for (unsigned int i = 0; i < passes.size(); ++i) {
+		if (passes[i].vertical)
+			verticalPass(passes[i], src, dst);
+		else
+			horizontalPass(passes[i], src, dst);
+		std::swap(src, dst);
+	}
+
+	// After an odd number of passes the result is in the scratch image
+	if (src.pixels != view.pixels) {
+		ImageViewT<PixelT> target = view;
+		target.blit(src, 0, 0);
+	}
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::horizontalPass(const Pass& pass, const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst) const
+{
+	typedef PixelTraits<PixelT> Traits;
+	typedef typename Traits::Accumulator Accumulator;
+	const unsigned int channels = Traits::color_channels;
+	const int width = src.width;
+	const int radius = pass.radius;
+	const int taps = 2 * radius + 1;
+	const float scale = 1.0f / taps;
+
+	// Source pixel of every sample of a row extended by the radius on both sides (one more for the last step of the box)
+	std::vector<int> samples(width + 2 * radius + 1);
+	for (int i = 0; i < (int)samples.size(); ++i)
+		samples[i] = edgeIndex(i - radius, width, edge);
+
+	PixelT black;
+	for (unsigned int c = 0; c < channels; ++c)
+		black.v[c] = 0;
+
+	parallelForRows(src.height, [&](unsigned int y_begin, unsigned int y_end) {
+		std::vector<PixelT> line(samples.size());
+		for (unsigned int y = y_begin; y < y_end; ++y)
+		{
+			const PixelT* in = src.getRow(y);
+			PixelT* out = dst.getRow(y);
+			for (unsigned int i = 0; i < line.size(); ++i)
+				line[i] = samples[i] >= 0 ? in[samples[i]] : black;
+			memcpy(out, in, width * sizeof(PixelT)); //keeps the alpha
+
+			if (pass.weights.empty())
+			{
+				// Running sum: add the sample entering the window, remove the one leaving it
+				for (unsigned int c = 0; c < channels; ++c) {
+					Accumulator sum = 0;
+					for (int k = 0; k < taps; ++k)
+						sum += line[k].v[c];
+					for (int x = 0; x < width; ++x) {
+						out[x].v[c] = toChannel<PixelT>(sum * scale);
+						sum += line[x + taps].v[c];
+						sum -= line[x].v[c];
+					}
+				}
+			}
+			else
+			{
+				const float* weights = &pass.weights[0];
+				for (int x = 0; x < width; ++x)
+					for (unsigned int c = 0; c < channels; ++c) {
+						float sum = 0;
+						for (int k = 0; k < taps; ++k)
+							sum += weights[k] * line[x + k].v[c];
+						out[x].v[c] = toChannel<PixelT>(sum);
+					}
+			}
+		}
+	});
+}
+
+template <typename PixelT>
+void SeparableBlurT<PixelT>::verticalPass(const Pass& pass, const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst) const
+{
+	typedef PixelTraits<PixelT> Traits;
+	typedef typename Traits::Accumulator Accumulator;
+	const unsigned int channels = Traits::color_channels;
+	const int height = src.height;
+	const int radius = pass.radius;
+	const int taps = 2 * radius + 1;
+	const float scale = 1.0f / taps;
+
+	// Source row of every sample of a column extended by the radius on both sides
+	std::vector<int> samples(height + 2 * radius);
+	for (int i = 0; i < (int)samples.size(); ++i)
+		samples[i] = edgeIndex(i - radius, height, edge);
+
+	// Every task takes a strip of columns and walks it down row by row, so the accesses stay in row order
+	parallelForRows(src.width, [&](unsigned int x_begin, unsigned int x_end) {
+		const unsigned int count = x_end - x_begin;
+		std::vector<Accumulator> sums(count * channels, 0);
+		std::vector<float> weighted(pass.weights.empty() ? 0 : count * channels);
+
+		// add or remove the strip of a source row from the sums (black rows do nothing)
+		auto addRow = [&](int row) {
+			if (row < 0) return;
+			const PixelT* in = src.getRow(row) + x_begin;
+			for (unsigned int i = 0; i < count; ++i)
+				for (unsigned int c = 0; c < channels; ++c)
+					sums[i * channels + c] += in[i].v[c];
+		};
+		auto removeRow = [&](int row) {
+			if (row < 0) return;
+			const PixelT* in = src.getRow(row) + x_begin;
+			for (unsigned int i = 0; i < count; ++i)
+				for (unsigned int c = 0; c < channels; ++c)
+					sums[i * channels + c] -= in[i].v[c];
+		};
+
+		if (pass.weights.empty())
+			for (int k = 0; k < taps; ++k)
+				addRow(samples[k]);
+
+		for (int y = 0; y < height; ++y)
+		{
+			PixelT* out = dst.getRow(y) + x_begin;
+			memcpy(out, src.getRow(y) + x_begin, count * sizeof(PixelT)); //keeps the alpha
+
+			if (pass.weights.empty())
+			{
+				for (unsigned int i = 0; i < count; ++i)
+					for (unsigned int c = 0; c < channels; ++c)
+						out[i].v[c] = toChannel<PixelT>(sums[i * channels + c] * scale);
+
+				// slide the window one row down
+				if (y + 1 < height) {
+					removeRow(samples[y]);
+					addRow(samples[y + taps]);
+				}
+			}
+			else
+			{
+				std::fill(weighted.begin(), weighted.end(), 0.0f);
+				for (int k = 0; k < taps; ++k) {
+					if (samples[y + k] < 0) continue;
+					const PixelT* in = src.getRow(samples[y + k]) + x_begin;
+					const float weight = pass.weights[k];
+					for (unsigned int i = 0; i < count; ++i)
+						for (unsigned int c = 0; c < channels; ++c)
+							weighted[i * channels + c] += weight * in[i].v[c];
+				}
+				for (unsigned int i = 0; i < count; ++i)
+					for (unsigned int c = 0; c < channels; ++c)
+						out[i].v[c] = toChannel<PixelT>(weighted[i * channels + c]);
+			}
+		}
+	});
+}
+
+// Pixel types the blur can be instantiated with
+template class SeparableBlurT<ColorGray8>;
+template class SeparableBlurT<Color>;
+template class SeparableBlurT<ColorRGBA>;
+template class SeparableBlurT<ColorRGB16>;
+template class SeparableBlurT<ColorRGBF32>;
@@ -0,0 +1,62 @@
+/*  blur.h
+	Separable blur of images: every blur is a horizontal pass over the rows followed by a vertical one
+	over the columns, each one reading one buffer and writing another (the view or a scratch image),
+	so no pass reads its own output.
+	Box passes keep a running sum, so they cost the same at any radius. Gaussian passes use precomputed
+	weights, and the fast Gaussian approximates one with three box passes to stay independent of sigma.
+	Rows are split between the threads in the horizontal passes and columns in the vertical ones.
+*/
+
+#ifndef BLUR_H
+#define BLUR_H
+
+#include "image.h"
+
+//what is sampled outside the image
+enum BlurEdge
+{
+	EDGE_CLAMP = 0, //repeat the border pixel
+	EDGE_MIRROR, //reflect at the border (without repeating it)
+	EDGE_WRAP, //continue from the other side
+	EDGE_BLACK //zero
+};
+
+template <typename PixelT>
+class SeparableBlurT
+{
+public:
+	SeparableBlurT(); //box of radius 1, clamped edges
+
+	// Kernel, the radius or sigma of each axis can be 0 to blur in one direction only
+	void setBox(unsigned int radius_x, unsigned int radius_y);
+	void setGaussian(float sigma_x, float sigma_y); //exact weights up to 3 sigma
+	void setFastGaussian(float sigma_x, float sigma_y); //three box passes, constant cost whatever sigma
+
+	void setEdge(BlurEdge edge) { this->edge = edge; }
+
+	// Blurs the view in place (alpha is kept)
+	void apply(const ImageViewT<PixelT>& view);
+
+private:
+	struct Pass
+	{
+		bool vertical;
+		unsigned int radius;
+		std::vector<float> weights; //2 * radius + 1 weights, empty for a box
+	};
+
+	std::vector<Pass> passes;
+	BlurEdge edge;
+	ImageT<PixelT> scratch; //kept between calls, only grows
+
+	void addBoxPass(bool vertical, unsigned int radius);
+	void addGaussianPass(bool vertical, float sigma);
+	void addFastGaussianPasses(bool vertical, float sigma);
+
+	void horizontalPass(const Pass& pass, const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst) const;
+	void verticalPass(const Pass& pass, const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst) const;
+};
+
+typedef SeparableBlurT<Color> SeparableBlur;
+
+#endif
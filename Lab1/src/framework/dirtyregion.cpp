@@ -0,0 +1,51 @@
+#include "dirtyregion.h"
+#include <algorithm>
+
+DirtyRect DirtyRect::merge(const DirtyRect& r) const
+{
+	const int x0 = std::min(x, r.x), y0 = std::min(y, r.y);
+	const int x1 = std::max(x + w, r.x + r.w), y1 = std::max(y + h, r.y + r.h);
+	return DirtyRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void DirtyRegion::add(const DirtyRect& rect)
+{
+	if (rect.w <= 0 || rect.h <= 0)
+		return;
+	for (size_t i = 0; i < rects.size(); ++i)
+		if (rects[i].contains(rect))
+			return;
+
+	//merge with every rectangle the bounding box does not waste pixels for, it can then reach others
+	DirtyRect merged = rect;
+	for (size_t i = 0; i < rects.size(); ) {
+		const DirtyRect candidate = merged.merge(rects[i]);
+		if (candidate.area() <= merged.area() + rects[i].area()) {
+			merged = candidate;
+			rects.erase(rects.begin() + i);
+			i = 0;
+		}
+		else
+			++i;
+	}
+	rects.push_back(merged);
+	if (rects.size() <= MAX_RECTS)
+		return;
+
+	//too many: the pair that adds the fewest pixels becomes one
+	size_t best_i = 0, best_j = 1;
+	long long best_growth = -1;
+	for (size_t i = 0; i < rects.size(); ++i)
+		for (size_t j = i + 1; j < rects.size(); ++j) {
+			const long long growth = rects[i].merge(rects[j]).area() - rects[i].area() - rects[j].area();
+			if (best_growth < 0 || growth < best_growth) {
+				best_growth = growth;
+				best_i = i;
+				best_j = j;
+			}
+		}
+	const DirtyRect pair = rects[best_i].merge(rects[best_j]);
+	rects.erase(rects.begin() + best_j);
+	rects.erase(rects.begin() + best_i);
+	add(pair);
+}
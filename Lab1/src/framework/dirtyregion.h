@@ -0,0 +1,42 @@
+/*  dirtyregion.h
+	Parts of an image written since they were last taken (for instance to send them to the screen), as a few rectangles.
+	A rectangle inside another one is dropped, and two are merged when their bounding box is not larger than both
+	of them together. Past MAX_RECTS the pair whose bounding box grows the least is merged, so the region never
+	costs more than a few uploads, but a brush stroke on one side and a particle on the other are not one big rectangle.
+*/
+
+#ifndef DIRTYREGION_H
+#define DIRTYREGION_H
+
+#include <vector>
+
+//Rectangle of pixels from (x,y) of size w,h
+struct DirtyRect
+{
+	int x, y, w, h;
+
+	DirtyRect() { x = y = w = h = 0; }
+	DirtyRect(int x, int y, int w, int h) { this->x = x; this->y = y; this->w = w; this->h = h; }
+
+	long long area() const { return (long long)w * h; }
+	bool contains(const DirtyRect& r) const { return r.x >= x && r.y >= y && r.x + r.w <= x + w && r.y + r.h <= y + h; }
+	DirtyRect merge(const DirtyRect& r) const; //bounding box of both
+};
+
+class DirtyRegion
+{
+public:
+	// Rectangles kept before the closest ones are merged
+	static const unsigned int MAX_RECTS = 8;
+
+	void add(const DirtyRect& rect); //empty rectangles are ignored
+	void clear() { rects.clear(); }
+
+	bool isEmpty() const { return rects.empty(); }
+	const std::vector<DirtyRect>& getRects() const { return rects; }
+
+private:
+	std::vector<DirtyRect> rects;
+};
+
+#endif
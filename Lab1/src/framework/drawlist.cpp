@@ -0,0 +1,323 @@
+#include "drawlist.h"
+#include "raster.h"
+
+// Bounds are kept inside this range, far from the overflow of int and from any view
+static const int BOUND_LIMIT = 1 << 30;
+
+// Pixel of a coordinate clamped to the range (NaN goes to the low end, so the bounds are empty)
+static int clampBound(double v)
+{
+	return v > -BOUND_LIMIT ? (v < BOUND_LIMIT ? (int)floor(v) : BOUND_LIMIT) : -BOUND_LIMIT;
+}
+
+template <typename PixelT>
+typename DrawListT<PixelT>::Command& DrawListT<PixelT>::push(DrawCommand type, long long x_min, long long y_min, long long x_max, long long y_max, const PixelT& c)
+{
+	Command command;
+	command.type = type;
+	command.flag = false;
+	command.x_min = (int)std::max(x_min, (long long)-BOUND_LIMIT);
+	command.y_min = (int)std::max(y_min, (long long)-BOUND_LIMIT);
+	command.x_max = (int)std::min(x_max, (long long)BOUND_LIMIT);
+	command.y_max = (int)std::min(y_max, (long long)BOUND_LIMIT);
+	command.c = c;
+	command.first = command.count = 0;
+	commands.push_back(command);
+	return commands.back();
+}
+
+// Command around float points, margin pixels beyond them for the edges of the anti-aliased shapes
+template <typename PixelT>
+typename DrawListT<PixelT>::Command& DrawListT<PixelT>::pushFloat(DrawCommand type, const Vector2* p, unsigned int count, float margin, const PixelT& c)
+{
+	double x_min = p[0].x, y_min = p[0].y, x_max = p[0].x, y_max = p[0].y;
+	for (unsigned int i = 1; i < count; ++i) {
+		x_min = std::min(x_min, (double)p[i].x); x_max = std::max(x_max, (double)p[i].x);
+		y_min = std::min(y_min, (double)p[i].y); y_max = std::max(y_max, (double)p[i].y);
+	}
+	Command& command = push(type, clampBound(x_min - margin - 1), clampBound(y_min - margin - 1), clampBound(x_max + margin + 1), clampBound(y_max + margin + 1), c);
+	for (unsigned int i = 0; i < count && i < 3; ++i) {
+		command.f[2 * i] = p[i].x;
+		command.f[2 * i + 1] = p[i].y;
+	}
+	return command;
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::fill(const PixelT& c)
+{
+	push(DRAW_FILL, -BOUND_LIMIT, -BOUND_LIMIT, BOUND_LIMIT, BOUND_LIMIT, c);
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::fillRect(int x, int y, int w, int h, const PixelT& c)
+{
+	if (w <= 0 || h <= 0)
+		return;
+	Command& command = push(DRAW_FILL_RECT, x, y, (long long)x + w - 1, (long long)y + h - 1, c);
+	command.i[0] = x; command.i[1] = y; command.i[2] = w; command.i[3] = h;
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawLine(int x0, int y0, int x1, int y1, const PixelT& c)
+{
+	Command& command = push(DRAW_LINE, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1), c);
+	command.i[0] = x0; command.i[1] = y0; command.i[2] = x1; command.i[3] = y1;
+	command.flag = true;
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawLines(const std::vector<Vector2>& points, const PixelT& c, bool closed)
+{
+	if (points.empty())
+		return;
+
+	//the same segments as Image::drawLines, only the last one of an open polyline draws its end
+	const unsigned int segments = (unsigned int)points.size() - (closed ? 0 : 1);
+	for (unsigned int i = 0; i < segments; ++i) {
+		const Vector2& a = points[i];
+		const Vector2& b = points[(i + 1) % points.size()];
+		drawLine((int)floor(a.x), (int)floor(a.y), (int)floor(b.x), (int)floor(b.y), c);
+		commands.back().flag = !closed && i + 1 == segments;
+	}
+	if (segments == 0)
+		drawLine((int)floor(points[0].x), (int)floor(points[0].y), (int)floor(points[0].x), (int)floor(points[0].y), c);
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawRectangle(int x, int y, int w, int h, const PixelT& c, bool fill)
+{
+	const int left = x - w / 2, top = y - h / 2;
+	if (fill) {
+		fillRect(left, top, w, h, c);
+		return;
+	}
+	if (w <= 0 || h <= 0)
+		return;
+
+	//the border as 4 rectangles, the corners belong to the horizontal edges
+	fillRect(left, top, w, 1, c);
+	if (h > 1) fillRect(left, top + h - 1, w, 1, c);
+	fillRect(left, top + 1, 1, h - 2, c);
+	if (w > 1) fillRect(left + w - 1, top + 1, 1, h - 2, c);
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawEllipse(int cx, int cy, int rx, int ry, const PixelT& c, bool fill)
+{
+	if (rx < 0 || ry < 0)
+		return;
+	Command& command = push(DRAW_ELLIPSE, (long long)cx - rx, (long long)cy - ry, (long long)cx + rx, (long long)cy + ry, c);
+	command.i[0] = cx; command.i[1] = cy; command.i[2] = rx; command.i[3] = ry;
+	command.flag = fill;
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, const PixelT& c, bool fill)
+{
+	if (!fill) {
+		std::vector<Vector2> outline = { p0, p1, p2 };
+		drawLines(outline, c, true);
+		return;
+	}
+	const Vector2 p[3] = { p0, p1, p2 };
+	pushFloat(DRAW_TRIANGLE, p, 3, 0, c);
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, const PixelT& c0, const PixelT& c1, const PixelT& c2)
+{
+	const Vector2 p[3] = { p0, p1, p2 };
+	Command& command = pushFloat(DRAW_TRIANGLE_GRADIENT, p, 3, 0, c0);
+	command.first = (unsigned int)colors.size();
+	colors.push_back(c1);
+	colors.push_back(c2);
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawPolygon(const std::vector<Vector2>& points, const PixelT& c, bool fill)
+{
+	if (!fill) {
+		drawLines(points, c, true);
+		return;
+	}
+	if (points.size() < 3)
+		return;
+	Command& command = pushFloat(DRAW_POLYGON, points.data(), (unsigned int)points.size(), 0, c);
+	command.first = (unsigned int)this->points.size();
+	command.count = (unsigned int)points.size();
+	this->points.insert(this->points.end(), points.begin(), points.end());
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawLineAA(const Vector2& p0, const Vector2& p1, const PixelT& c)
+{
+	const Vector2 p[2] = { p0, p1 };
+	pushFloat(DRAW_LINE_AA, p, 2, 1, c);
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawCircleAA(const Vector2& center, float r, const PixelT& c, bool fill)
+{
+	if (!(r >= 0))
+		return;
+	Command& command = pushFloat(DRAW_CIRCLE_AA, &center, 1, r + 1, c);
+	command.f[2] = r;
+	command.flag = fill;
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::fillRectAA(float x, float y, float w, float h, const PixelT& c)
+{
+	const Vector2 p[2] = { Vector2(x, y), Vector2(x + w, y + h) };
+	Command& command = pushFloat(DRAW_RECT_AA, p, 2, 0, c);
+	command.f[2] = w;
+	command.f[3] = h;
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::drawPolygonAA(const std::vector<Vector2>& points, const PixelT& c, bool fill)
+{
+	if (points.empty())
+		return;
+	if (!fill) {
+		//the same edges as Image::drawPolygonAA
+		if (points.size() == 2)
+			drawLineAA(points[0], points[1], c);
+		else
+			for (size_t i = 0; i < points.size(); ++i)
+				drawLineAA(points[i], points[(i + 1) % points.size()], c);
+		return;
+	}
+	Command& command = pushFloat(DRAW_POLYGON_AA, points.data(), (unsigned int)points.size(), 1, c);
+	command.first = (unsigned int)this->points.size();
+	command.count = (unsigned int)points.size();
+	this->points.insert(this->points.end(), points.begin(), points.end());
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::blit(const ImageViewT<PixelT>& src, int x, int y)
+{
+	if (src.isEmpty())
+		return;
+	Command& command = push(DRAW_BLIT, x, y, (long long)x + src.width - 1, (long long)y + src.height - 1, PixelT());
+	command.i[0] = x; command.i[1] = y;
+	command.first = (unsigned int)sources.size();
+	sources.push_back(src);
+}
+
+// Range of tiles [tiles[0],tiles[2]] x [tiles[1],tiles[3]] the bounds of the command touch inside dst, false when none
+template <typename PixelT>
+bool DrawListT<PixelT>::getTiles(const Command& command, const ImageViewT<PixelT>& dst, unsigned int* tiles) const
+{
+	const int x_min = std::max(command.x_min, 0), x_max = std::min(command.x_max, (int)dst.width - 1);
+	const int y_min = std::max(command.y_min, 0), y_max = std::min(command.y_max, (int)dst.height - 1);
+	if (x_min > x_max || y_min > y_max)
+		return false;
+	tiles[0] = x_min / TILE_SIZE; tiles[1] = y_min / TILE_SIZE;
+	tiles[2] = x_max / TILE_SIZE; tiles[3] = y_max / TILE_SIZE;
+	return true;
+}
+
+// Draws a command into the tile whose origin is at (x,y) of the target
+template <typename PixelT>
+void DrawListT<PixelT>::draw(const Command& command, ImageViewT<PixelT> tile, int x, int y, std::vector<Vector2>& moved) const
+{
+	const int* i = command.i;
+	const PixelT& c = command.c;
+	auto point = [&](int k) { return Vector2(command.f[2 * k] - x, command.f[2 * k + 1] - y); };
+	auto movePoints = [&]() -> const std::vector<Vector2>& {
+		moved.resize(command.count);
+		for (unsigned int k = 0; k < command.count; ++k)
+			moved[k] = Vector2(points[command.first + k].x - x, points[command.first + k].y - y);
+		return moved;
+	};
+
+	switch (command.type)
+	{
+	case DRAW_FILL: tile.fill(c); break;
+	case DRAW_FILL_RECT: tile.fillRect(i[0] - x, i[1] - y, i[2], i[3], c); break;
+	case DRAW_LINE: tile.drawLine(i[0] - x, i[1] - y, i[2] - x, i[3] - y, c, command.flag); break;
+	case DRAW_ELLIPSE: tile.drawEllipse(i[0] - x, i[1] - y, i[2], i[3], c, command.flag); break;
+	case DRAW_TRIANGLE: fillTriangle(tile, point(0), point(1), point(2), c); break;
+	case DRAW_TRIANGLE_GRADIENT: fillTriangle(tile, point(0), point(1), point(2), c, colors[command.first], colors[command.first + 1]); break;
+	case DRAW_POLYGON: fillPolygon(tile, movePoints(), c); break;
+	case DRAW_LINE_AA: strokeLineAA(tile, point(0), point(1), c); break;
+	case DRAW_CIRCLE_AA:
+		if (command.flag)
+			fillCircleAA(tile, point(0), command.f[2], c);
+		else
+			strokeCircleAA(tile, point(0), command.f[2], c);
+		break;
+	case DRAW_RECT_AA: ::fillRectAA(tile, command.f[0] - x, command.f[1] - y, command.f[2], command.f[3], c); break;
+	case DRAW_POLYGON_AA: fillPolygonAA(tile, movePoints(), c); break;
+	case DRAW_BLIT: tile.blit(sources[command.first], i[0] - x, i[1] - y); break;
+	}
+}
+
+template <typename PixelT>
+void DrawListT<PixelT>::execute(const ImageViewT<PixelT>& dst) const
+{
+	if (dst.isEmpty() || commands.empty())
+		return;
+	const unsigned int tiles_x = (dst.width + TILE_SIZE - 1) / TILE_SIZE;
+	const unsigned int tiles_y = (dst.height + TILE_SIZE - 1) / TILE_SIZE;
+	const unsigned int num_tiles = tiles_x * tiles_y;
+
+	//a command covering a whole tile with opaque pixels is the first one it draws
+	auto coversTile = [&](const Command& command, unsigned int tile_x, unsigned int tile_y) {
+		if (command.type != DRAW_FILL && command.type != DRAW_FILL_RECT && command.type != DRAW_BLIT)
+			return false;
+		const int x_begin = tile_x * TILE_SIZE, x_end = std::min(x_begin + TILE_SIZE, dst.width);
+		const int y_begin = tile_y * TILE_SIZE, y_end = std::min(y_begin + TILE_SIZE, dst.height);
+		return command.x_min <= x_begin && command.y_min <= y_begin && command.x_max >= x_end - 1 && command.y_max >= y_end - 1;
+	};
+
+	//counting sort of the commands by tile, which keeps their order inside every tile
+	std::vector<unsigned int> first(num_tiles, 0), offsets(num_tiles + 1, 0);
+	unsigned int tiles[4];
+	for (unsigned int i = 0; i < commands.size(); ++i) {
+		if (!getTiles(commands[i], dst, tiles))
+			continue;
+		for (unsigned int ty = tiles[1]; ty <= tiles[3]; ++ty)
+			for (unsigned int tx = tiles[0]; tx <= tiles[2]; ++tx) {
+				const unsigned int t = ty * tiles_x + tx;
+				if (coversTile(commands[i], tx, ty)) { first[t] = i; offsets[t + 1] = 1; }
+				else ++offsets[t + 1];
+			}
+	}
+	for (unsigned int t = 0; t < num_tiles; ++t)
+		offsets[t + 1] += offsets[t];
+
+	//the commands are copied to the bins, so every tile reads its own ones one after the other
+	std::vector<Command> bins(offsets[num_tiles]);
+	std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i = 0; i < commands.size(); ++i) {
+		if (!getTiles(commands[i], dst, tiles))
+			continue;
+		for (unsigned int ty = tiles[1]; ty <= tiles[3]; ++ty)
+			for (unsigned int tx = tiles[0]; tx <= tiles[2]; ++tx) {
+				const unsigned int t = ty * tiles_x + tx;
+				if (i >= first[t])
+					bins[next[t]++] = commands[i];
+			}
+	}
+
+	//every tile draws its list, the shapes split between threads inside a tile run on the thread of the tile
+	parallelForTiles(dst.width, dst.height, TILE_SIZE, [&](unsigned int x_begin, unsigned int y_begin, unsigned int x_end, unsigned int y_end) {
+		const unsigned int t = (y_begin / TILE_SIZE) * tiles_x + x_begin / TILE_SIZE;
+		if (offsets[t] == offsets[t + 1])
+			return;
+		const ImageViewT<PixelT> tile = dst.getSubView(x_begin, y_begin, x_end - x_begin, y_end - y_begin);
+		std::vector<Vector2> moved;
+		for (unsigned int k = offsets[t]; k < offsets[t + 1]; ++k)
+			draw(bins[k], tile, x_begin, y_begin, moved);
+	});
+}
+
+// Pixel types a draw list can be recorded for
+template class DrawListT<ColorGray8>;
+template class DrawListT<Color>;
+template class DrawListT<ColorRGBA>;
+template class DrawListT<ColorRGB16>;
+template class DrawListT<ColorRGBF32>;
@@ -0,0 +1,96 @@
+/*  drawlist.h
+	Command buffer for the shapes of a frame: the calls are recorded instead of drawn, and execute() draws all of them
+	at once by square tiles of the target. Every command is binned to the tiles its bounding box touches, in the order
+	it was recorded, and every tile replays its own list on a worker thread, so the pixels of a tile stay in the cache
+	while all its shapes are drawn and thousands of small shapes are spread over all the threads.
+	A command that covers a whole tile with opaque pixels (fill, a filled rectangle, a blit) hides the previous ones,
+	so they are not drawn in that tile at all.
+	A tile draws the shapes moved to its own origin: the ones with integer coordinates (lines, rectangles, ellipses,
+	blits) write exactly the pixels they write when drawn directly, the ones with float coordinates can round their
+	position differently by a tiny fraction of a pixel.
+*/
+
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include "image.h"
+
+//Shapes a draw list can record
+enum DrawCommand
+{
+	DRAW_FILL = 0,
+	DRAW_FILL_RECT,
+	DRAW_LINE,
+	DRAW_ELLIPSE,
+	DRAW_TRIANGLE,
+	DRAW_TRIANGLE_GRADIENT,
+	DRAW_POLYGON,
+	DRAW_LINE_AA,
+	DRAW_CIRCLE_AA,
+	DRAW_RECT_AA,
+	DRAW_POLYGON_AA,
+	DRAW_BLIT
+};
+
+//Class DrawListT: records drawing commands and draws them by tiles in parallel
+//  list.clear(); list.fill(Color::BLACK); list.fillRect(...); list.drawCircle(...); framebuffer.draw(list);
+//The methods draw the same shapes as the ones of Image (see image.h and raster.h) in the coordinates of the target
+template <typename PixelT>
+class DrawListT
+{
+public:
+	// Side of the tiles, 64x64 pixels of 3 bytes are 12KB
+	static const unsigned int TILE_SIZE = 64;
+
+	// Record a command, they are drawn in the same order
+	void fill(const PixelT& c);
+	void fillRect(int x, int y, int w, int h, const PixelT& c);
+	void drawLine(int x0, int y0, int x1, int y1, const PixelT& c); //both ends included
+	void drawLines(const std::vector<Vector2>& points, const PixelT& c, bool closed = false); //the shared ends are drawn once
+	void drawRectangle(int x, int y, int w, int h, const PixelT& c, bool fill); //centred on (x,y) like Image::drawRectangle
+	void drawEllipse(int cx, int cy, int rx, int ry, const PixelT& c, bool fill);
+	void drawCircle(int cx, int cy, int r, const PixelT& c, bool fill) { drawEllipse(cx, cy, r, r, c, fill); }
+	void drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, const PixelT& c, bool fill);
+	void drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, const PixelT& c0, const PixelT& c1, const PixelT& c2);
+	void drawPolygon(const std::vector<Vector2>& points, const PixelT& c, bool fill);
+	void drawLineAA(const Vector2& p0, const Vector2& p1, const PixelT& c);
+	void drawCircleAA(const Vector2& center, float r, const PixelT& c, bool fill);
+	void fillRectAA(float x, float y, float w, float h, const PixelT& c); //from the corner (x,y)
+	void drawPolygonAA(const std::vector<Vector2>& points, const PixelT& c, bool fill);
+	void blit(const ImageViewT<PixelT>& src, int x, int y); //src is read in execute(), it must still be alive and can not be the target
+
+	unsigned int size() const { return (unsigned int)commands.size(); }
+	bool isEmpty() const { return commands.empty(); }
+	void clear() { commands.clear(); points.clear(); colors.clear(); sources.clear(); }
+
+	// Draws the recorded commands into dst, the tiles in parallel and the commands of every tile in order
+	void execute(const ImageViewT<PixelT>& dst) const;
+
+private:
+	struct Command
+	{
+		DrawCommand type;
+		bool flag; //filled, or the last pixel of a line
+		int x_min, y_min, x_max, y_max; //pixels it can write (inclusive)
+		union
+		{
+			int i[4]; //integer coordinates
+			float f[6]; //up to 3 points, or a point and a size
+		};
+		PixelT c;
+		unsigned int first, count; //in points (polygons), colors (the other 2 of a gradient) or sources (a blit)
+	};
+	std::vector<Command> commands;
+	std::vector<Vector2> points; //of all the polygons
+	std::vector<PixelT> colors;
+	std::vector<ImageViewT<PixelT>> sources;
+
+	Command& push(DrawCommand type, long long x_min, long long y_min, long long x_max, long long y_max, const PixelT& c);
+	Command& pushFloat(DrawCommand type, const Vector2* p, unsigned int count, float margin, const PixelT& c);
+	bool getTiles(const Command& command, const ImageViewT<PixelT>& dst, unsigned int* tiles) const;
+	void draw(const Command& command, ImageViewT<PixelT> tile, int x, int y, std::vector<Vector2>& moved) const;
+};
+
+typedef DrawListT<Color> DrawList;
+
+#endif
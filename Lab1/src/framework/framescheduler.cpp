@@ -0,0 +1,101 @@
+#include "framescheduler.h"
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+
+static const long long SECOND_NS = 1000000000;
+
+FrameScheduler::FrameScheduler(double update_rate, double frame_rate)
+{
+	setUpdateRate(update_rate);
+	setFrameRate(frame_rate);
+	steps = 0;
+	alpha = 1;
+	frames = missed = 0;
+	reset();
+}
+
+long long FrameScheduler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameScheduler::setUpdateRate(double rate)
+{
+	step_ns = rate > 0 ? (long long)(SECOND_NS / rate) : SECOND_NS / 60;
+}
+
+void FrameScheduler::setFrameRate(double rate)
+{
+	frame_ns = rate > 0 ? (long long)(SECOND_NS / rate) : 0;
+}
+
+void FrameScheduler::reset()
+{
+	last_time = now();
+	accumulator = 0;
+	deadline = last_time + frame_ns;
+	frame_steps = 0;
+	report_missed = 0;
+	report_time = last_time;
+	report_worst = 0;
+}
+
+void FrameScheduler::beginFrame()
+{
+	const long long t = now();
+	accumulator += t - last_time;
+	last_time = t;
+	frame_steps = 0;
+
+	//too far behind (a breakpoint, a slow filter...): the time of the steps that do not fit is lost
+	if (accumulator > MAX_STEPS_PER_FRAME * step_ns)
+		accumulator = MAX_STEPS_PER_FRAME * step_ns;
+}
+
+bool FrameScheduler::step()
+{
+	if (accumulator >= step_ns && frame_steps < MAX_STEPS_PER_FRAME) {
+		accumulator -= step_ns;
+		++steps;
+		++frame_steps;
+		return true;
+	}
+	alpha = (float)((double)accumulator / step_ns);
+	return false;
+}
+
+void FrameScheduler::endFrame()
+{
+	++frames;
+	long long t = now();
+
+	if (frame_ns) {
+		if (t > deadline) {
+			//late: no wait, and the next deadline starts from now when a whole frame was lost
+			const long long late = t - deadline;
+			++missed;
+			++report_missed;
+			if (late > report_worst)
+				report_worst = late;
+			deadline = late >= frame_ns ? t + frame_ns : deadline + frame_ns;
+		}
+		else {
+			//the sleep can wake up late, the last part is spun
+			if (deadline - t > SPIN_NS)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - t - SPIN_NS));
+			while (now() < deadline)
+				std::this_thread::yield();
+			deadline += frame_ns;
+		}
+	}
+
+	//at most one line per second
+	if (t - report_time >= SECOND_NS) {
+		if (report_missed)
+			printf("frame scheduler: %u frames missed their deadline in the last second (worst %.2f ms late)\n", report_missed, report_worst * 1e-6);
+		report_missed = 0;
+		report_worst = 0;
+		report_time = t;
+	}
+}
@@ -0,0 +1,64 @@
+/*  framescheduler.h
+	Timing of the main loop with a monotonic clock in nanoseconds. update runs at a fixed time step: the real
+	time of every frame goes into an accumulator and as many steps as fit in it are run, so the simulation
+	moves the same at any frame rate. The time left in the accumulator, as a fraction of a step, is the
+	interpolation factor render can use to draw between the last two states.
+	Frames are paced to a target rate: the thread sleeps until a bit before the deadline and spins the rest,
+	because a sleep can wake up late. Frames that end after their deadline are counted and reported.
+*/
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+class FrameScheduler
+{
+public:
+	// Most update steps in a frame, after a long frame the rest of the time is dropped instead of catching up
+	static const unsigned int MAX_STEPS_PER_FRAME = 5;
+
+	// Time before a deadline that is spun instead of slept
+	static const long long SPIN_NS = 2000000;
+
+	FrameScheduler(double update_rate = 60, double frame_rate = 60);
+
+	// Monotonic clock in nanoseconds
+	static long long now();
+
+	void setUpdateRate(double rate); //steps per second
+	void setFrameRate(double rate); //0 does not wait (no frame cap)
+	double getTimeStep() const { return step_ns * 1e-9; } //seconds of every update step
+	double getFrameRate() const { return frame_ns ? 1e9 / frame_ns : 0; }
+
+	// Starts counting from now, for instance after the loop was stopped for a while (nothing is accumulated)
+	void reset();
+
+	// Adds the real time since the last call to the accumulator
+	void beginFrame();
+
+	// True while a whole step is left in the accumulator (and it takes it), the simulated time advances a step
+	//  scheduler.beginFrame(); while (scheduler.step()) app->update(scheduler.getTimeStep());
+	bool step();
+
+	double getTime() const { return steps * getTimeStep(); } //seconds simulated
+	float getAlpha() const { return alpha; } //[0,1) part of the next step already elapsed, 1 when not running
+
+	// Waits until the deadline of the frame (sleep, then spin) and sets the next one
+	void endFrame();
+
+	unsigned long long getFrames() const { return frames; }
+	unsigned long long getMissedFrames() const { return missed; }
+
+private:
+	long long step_ns, frame_ns;
+	long long last_time, accumulator;
+	long long deadline;
+	unsigned long long steps;
+	unsigned int frame_steps;
+	float alpha;
+
+	unsigned long long frames, missed;
+	unsigned int report_missed; //since the last report
+	long long report_time, report_worst;
+};
+
+#endif
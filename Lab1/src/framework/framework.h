@@ -62,6 +62,30 @@ public:
 
 inline Color operator * (const Color& c, float v) { return Color((unsigned char)(c.r*v), (unsigned char)(c.g*v), (unsigned char)(c.b*v)); }
 inline Color operator * (float v, const Color& c) { return Color((unsigned char)(c.r*v), (unsigned char)(c.g*v), (unsigned char)(c.b*v)); }
+
+//Color with an alpha channel, 4 bytes so every pixel fills a 32 bit word (good for SIMD)
+//Used without alpha (RGBX) the fourth byte is just padding and stays at 255
+class ColorRGBA
+{
+public:
+	union
+	{
+		struct { unsigned char r;
+				 unsigned char g;
+				 unsigned char b;
+				 unsigned char a; };
+		unsigned char v[4];
+	};
+	ColorRGBA() { r = g = b = 0; a = 255; }
+	ColorRGBA(float r, float g, float b, float a = 255) { this->r = (unsigned char)r; this->g = (unsigned char)g; this->b = (unsigned char)b; this->a = (unsigned char)a; }
+	explicit ColorRGBA(const Color& c, unsigned char a = 255) { r = c.r; g = c.g; b = c.b; this->a = a; }
+
+	void set(float r, float g, float b) { this->r = (unsigned char)clamp(r,0.0,255.0); this->g = (unsigned char)clamp(g,0.0,255.0); this->b = (unsigned char)clamp(b,0.0,255.0); }
+	void set(float r, float g, float b, float a) { set(r, g, b); this->a = (unsigned char)clamp(a,0.0,255.0); }
+
+	//drops the alpha channel
+	Color toColor() const { Color c; c.r = r; c.g = g; c.b = b; return c; }
+};
 //*********************************
 
 class Vector3
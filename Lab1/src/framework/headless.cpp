@@ -0,0 +1,73 @@
+#include "headless.h"
+#include "application.h"
+#include <chrono>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void launchHeadlessLoop(Application* app, const HeadlessSettings& settings)
+{
+	double render_time = 0, update_time = 0;
+
+	// Key events sorted by frame, the ones of the same frame keep their order
+	std::vector<HeadlessKey> keys = settings.keys;
+	std::stable_sort(keys.begin(), keys.end(), [](const HeadlessKey& a, const HeadlessKey& b) { return a.frame < b.frame; });
+	size_t next_key = 0;
+
+	for (unsigned int frame = 0; frame < settings.frames; ++frame)
+	{
+		// Update keyboard state
+		memcpy(app->prev_keystate, app->current_keystate, SDL_NUM_SCANCODES);
+		memcpy((void*)&(app->current_keystate), app->keystate, SDL_NUM_SCANCODES);
+
+		// Call render function
+		Clock::time_point start = Clock::now();
+		app->render( app->framebuffer );
+		render_time += millisecondsSince(start);
+
+		// Instead of sending it to the GPU, save it like a screenshot (the rows flipped like the window)
+		if (!settings.dump_path.empty())
+		{
+			char number[16];
+			sprintf(number, "%04u.tga", frame);
+			app->framebuffer.getView().saveTGA((settings.dump_path + number).c_str(), true);
+		}
+		app->framebuffer.takeDirtyRects();
+
+		// Scripted key events of this frame
+		for (; next_key < keys.size() && keys[next_key].frame <= frame; ++next_key)
+		{
+			const HeadlessKey& key = keys[next_key];
+			if (key.scancode <= 0 || key.scancode >= SDL_NUM_SCANCODES)
+				continue;
+			SDL_KeyboardEvent event;
+			memset(&event, 0, sizeof(event));
+			event.type = key.pressed ? SDL_KEYDOWN : SDL_KEYUP;
+			event.state = key.pressed ? SDL_PRESSED : SDL_RELEASED;
+			event.keysym.scancode = (SDL_Scancode)key.scancode;
+			app->headless_keystate[key.scancode] = key.pressed ? 1 : 0;
+			if (key.pressed)
+				app->onKeyDown(event);
+			else
+				app->onKeyUp(event);
+		}
+
+		// The mouse does not move
+		app->mouse_state = 0;
+		app->mouse_delta.set(0, 0);
+
+		// Update logic with the synthetic clock
+		app->app_time = (frame + 1) * settings.frame_time;
+		start = Clock::now();
+		app->update(settings.frame_time);
+		update_time += millisecondsSince(start);
+	}
+
+	if (settings.frames)
+		printf("headless: %u frames, render %.3f ms, update %.3f ms per frame\n", settings.frames, render_time / settings.frames, update_time / settings.frames);
+}
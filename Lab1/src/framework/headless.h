@@ -0,0 +1,38 @@
+/*  headless.h
+	Runs the application without a window or an OpenGL context (nothing of SDL is initialised). render and update
+	are called in the same order as in launchLoop, with a synthetic clock that advances a fixed time every frame,
+	and the framebuffer only lives in memory. Key events can be scripted by frame, the frames can be saved to disk
+	to compare them between builds, and the time spent rendering and updating is reported at the end, so the whole
+	frame pipeline can be benchmarked and tested on machines without a display.
+*/
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+
+class Application;
+
+//A key going down or up in the events of a frame (after it is rendered, like the ones of SDL)
+struct HeadlessKey
+{
+	unsigned int frame;
+	int scancode; //SDL_Scancode
+	bool pressed;
+};
+
+struct HeadlessSettings
+{
+	unsigned int frames; //frames to run
+	double frame_time; //seconds the clock advances every frame
+	std::string dump_path; //prefix of the TGA saved for every frame ("out/frame" saves out/frame0000.tga...), empty saves none
+	std::vector<HeadlessKey> keys;
+
+	HeadlessSettings() { frames = 100; frame_time = 1.0 / 60; }
+};
+
+// Runs all the frames and prints the mean time of render and update per frame
+void launchHeadlessLoop(Application* app, const HeadlessSettings& settings);
+
+#endif
@@ -1,126 +1,380 @@
 #include "image.h"
+#include "simd.h"
+#include "lut.h"
+#include "blur.h"
+#include "integral.h"
+#include "warp.h"
+#include "resample.h"
+#include "mipmap.h"
+#include "raster.h"
+#include "drawlist.h"
+#include <limits>
+#include <functional>
+
+#ifdef _MSC_VER
+	#include <malloc.h> //_aligned_malloc
+#else
+	#include <stdlib.h> //posix_memalign
+#endif
 
 using namespace std;
 
-Image::Image() {
+// Allocates count default pixels (black) starting on a BUFFER_ALIGNMENT boundary
+template <typename PixelT>
+static PixelT* allocatePixels(size_t count)
+{
+	if (count == 0)
+		return NULL;
+
+	void* memory = NULL;
+#ifdef _MSC_VER
+	memory = _aligned_malloc(count * sizeof(PixelT), ImageT<PixelT>::BUFFER_ALIGNMENT);
+#else
+	if (posix_memalign(&memory, ImageT<PixelT>::BUFFER_ALIGNMENT, count * sizeof(PixelT)) != 0)
+		memory = NULL;
+#endif
+	if (memory == NULL)
+		throw std::bad_alloc();
+
+	PixelT* pixels = (PixelT*)memory;
+	std::uninitialized_fill_n(pixels, count, PixelT());
+	return pixels;
+}
+
+void PixelDeleter::operator()(void* pixels) const
+{
+#ifdef _MSC_VER
+	_aligned_free(pixels);
+#else
+	free(pixels);
+#endif
+}
+
+// Smallest row length (in pixels) not below width whose size in bytes is a multiple of row_alignment
+static unsigned int computeStride(unsigned int width, unsigned int row_alignment, unsigned int pixel_size)
+{
+	unsigned int stride = width;
+	if (row_alignment > 1)
+		while ((stride * pixel_size) % row_alignment)
+			++stride;
+	return stride;
+}
+
+template <typename PixelT>
+ImageT<PixelT>::ImageT() : modified(false), all_dirty(true) {
 	width = 0; height = 0;
-	pixels = NULL;
+	stride = 0; row_alignment = 1;
 }
 
-Image::Image(unsigned int width, unsigned int height)
+template <typename PixelT>
+ImageT<PixelT>::ImageT(unsigned int width, unsigned int height, unsigned int row_alignment) : modified(false), all_dirty(true)
 {
 	this->width = width;
 	this->height = height;
-	pixels = new Color[width*height];
-	memset(pixels, 0, width * height * sizeof(Color));
+	this->row_alignment = row_alignment ? row_alignment : 1;
+	stride = computeStride(width, this->row_alignment, sizeof(PixelT));
+	pixels.reset(allocatePixels<PixelT>(stride * height)); //padding included
 }
 
-//copy constructor
-Image::Image(const Image& c) {
-	pixels = NULL;
-
+//copy constructor (keeps the layout of c, the mipmaps are not copied)
+template <typename PixelT>
+ImageT<PixelT>::ImageT(const ImageT& c) : modified(false), all_dirty(true) {
 	width = c.width;
 	height = c.height;
+	stride = c.stride;
+	row_alignment = c.row_alignment;
 	if(c.pixels)
 	{
-		pixels = new Color[width*height];
-		memcpy(pixels, c.pixels, width*height*sizeof(Color));
+		pixels.reset(allocatePixels<PixelT>(stride * height));
+		memcpy(pixels.get(), c.pixels.get(), stride*height*sizeof(PixelT));
 	}
 }
 
-//assign operator
-Image& Image::operator = (const Image& c)
+//move constructor
+template <typename PixelT>
+ImageT<PixelT>::ImageT(ImageT&& c) : pixels(std::move(c.pixels)), mipmaps(std::move(c.mipmaps)), modified(c.modified.load()),
+	dirty_region(std::move(c.dirty_region)), all_dirty(c.all_dirty.load())
 {
-	if(pixels) delete pixels;
-	pixels = NULL;
-
 	width = c.width;
 	height = c.height;
-	if(c.pixels)
+	stride = c.stride;
+	row_alignment = c.row_alignment;
+	c.width = 0;
+	c.height = 0;
+	c.stride = 0;
+}
+
+//assign operator
+template <typename PixelT>
+ImageT<PixelT>& ImageT<PixelT>::operator = (const ImageT& c)
+{
+	if(this != &c)
 	{
-		pixels = new Color[width*height*sizeof(Color)];
-		memcpy(pixels, c.pixels, width*height*sizeof(Color));
+		ImageT copy(c);
+		swap(copy);
 	}
 	return *this;
 }
 
-Image::~Image()
+//move assign operator
+template <typename PixelT>
+ImageT<PixelT>& ImageT<PixelT>::operator = (ImageT&& c)
 {
-	if(pixels) 
-		delete pixels;
+	if(this != &c)
+	{
+		pixels = std::move(c.pixels);
+		mipmaps = std::move(c.mipmaps);
+		modified = c.modified.load();
+		dirty_region = std::move(c.dirty_region);
+		all_dirty = c.all_dirty.load();
+		width = c.width;
+		height = c.height;
+		stride = c.stride;
+		row_alignment = c.row_alignment;
+		c.width = 0;
+		c.height = 0;
+		c.stride = 0;
+	}
+	return *this;
+}
+
+template <typename PixelT>
+void ImageT<PixelT>::swap(ImageT& other)
+{
+	std::swap(width, other.width);
+	std::swap(height, other.height);
+	std::swap(stride, other.stride);
+	std::swap(row_alignment, other.row_alignment);
+	pixels.swap(other.pixels);
+	mipmaps.swap(other.mipmaps);
+	const bool other_modified = other.modified.load();
+	other.modified = modified.load();
+	modified = other_modified;
+	std::swap(dirty_region, other.dirty_region);
+	const bool other_dirty = other.all_dirty.load();
+	other.all_dirty = all_dirty.load();
+	all_dirty = other_dirty;
+}
+
+template <typename PixelT>
+void ImageT<PixelT>::setRowAlignment(unsigned int row_alignment)
+{
+	if (row_alignment == 0) row_alignment = 1;
+	if (row_alignment == this->row_alignment) return;
+
+	ImageT result(width, height, row_alignment);
+	result.blit(getView(), 0, 0);
+	*this = std::move(result);
 }
 
 
 
 //change image size (the old one will remain in the top-left corner)
-void Image::resize(unsigned int width, unsigned int height)
+template <typename PixelT>
+void ImageT<PixelT>::resize(unsigned int width, unsigned int height)
 {
-	Color* new_pixels = new Color[width*height];
-	unsigned int min_width = this->width > width ? width : this->width;
-	unsigned int min_height = this->height > height ? height : this->height;
+	ImageT result(width, height, row_alignment);
+	result.blit(getView(), 0, 0);
+	*this = std::move(result);
+}
 
-	for(unsigned int x = 0; x < min_width; ++x)
-		for(unsigned int y = 0; y < min_height; ++y)
-			new_pixels[ y * width + x ] = getPixel(x,y);
+//change image size and scale the content
+template <typename PixelT>
+void ImageT<PixelT>::scale(unsigned int width, unsigned int height, ResampleFilter filter)
+{
+	ImageT result(width, height, row_alignment);
+	if (filter != RESAMPLE_NEAREST && hasMipmaps())
+		resampleMipmapped(*this, result.getView(), filter); //starts from the level closest to the new size
+	else
+		resample(getView(), result.getView(), filter);
+	*this = std::move(result);
+}
 
-	delete pixels;
-	this->width = width;
-	this->height = height;
-	pixels = new_pixels;
+template <typename PixelT>
+void ImageT<PixelT>::markModified(int x, int y, int w, int h) const
+{
+	modified.store(true, std::memory_order_relaxed);
+	const int x0 = std::max(x, 0), x1 = (int)std::min((long long)x + w, (long long)width);
+	const int y0 = std::max(y, 0), y1 = (int)std::min((long long)y + h, (long long)height);
+	if (x0 < x1 && y0 < y1)
+		dirty_region.add(DirtyRect(x0, y0, x1 - x0, y1 - y0));
 }
 
-//change image size and scale the content
-void Image::scale(unsigned int width, unsigned int height)
+template <typename PixelT>
+std::vector<DirtyRect> ImageT<PixelT>::takeDirtyRects()
 {
-	Color* new_pixels = new Color[width*height];
+	std::vector<DirtyRect> rects;
+	if (all_dirty.exchange(false, std::memory_order_relaxed)) {
+		if (width && height)
+			rects.push_back(DirtyRect(0, 0, width, height));
+	}
+	else
+		rects = dirty_region.getRects();
+	dirty_region.clear();
+	return rects;
+}
 
-	for(unsigned int x = 0; x < width; ++x)
-		for(unsigned int y = 0; y < height; ++y)
-			new_pixels[ y * width + x ] = getPixel((unsigned int)(this->width * (x / (float)width)), (unsigned int)(this->height * (y / (float)height)) );
+template <typename PixelT>
+const MipmapT<PixelT>& ImageT<PixelT>::getMipmaps() const
+{
+	if (!hasMipmaps()) {
+		modified = false;
+		mipmaps = std::make_shared<const MipmapT<PixelT>>(getView());
+	}
+	return *mipmaps;
+}
 
-	delete pixels;
-	this->width = width;
-	this->height = height;
-	pixels = new_pixels;
+template <typename PixelT>
+ImageViewT<PixelT> ImageT<PixelT>::getMipmapLevel(unsigned int level) const
+{
+	if (level == 0)
+		return getView();
+	const MipmapT<PixelT>& levels = getMipmaps();
+	return levels.getLevel(std::min(level, levels.getLevelCount() - 1));
 }
 
-Image Image::getArea(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height)
+template <typename PixelT>
+ImageT<PixelT> ImageT<PixelT>::getArea(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height)
 {
-	Image result(width, height);
-	for(unsigned int x = 0; x < width; ++x)
-		for(unsigned int y = 0; y < height; ++y)
-		{
-			if( (x + start_x) < this->width && (y + start_y) < this->height) 
-				result.setPixel( x, y, getPixel(x + start_x,y + start_y) );
-		}
+	//the part outside the image stays black
+	ImageT result(width, height, row_alignment);
+	result.blit(getView(start_x, start_y, width, height), 0, 0);
 	return result;
 }
 
-void Image::flipX()
+template <typename PixelT>
+ImageViewT<PixelT> ImageViewT<PixelT>::getSubView(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height) const
 {
-	for(unsigned int x = 0; x < width * 0.5; ++x)
-		for(unsigned int y = 0; y < height; ++y)
-		{
-			Color temp = getPixel(width - x - 1, y);
-			setPixel( width - x - 1, y, getPixel(x,y));
-			setPixel( x, y, temp );
-		}
+	if (start_x >= this->width || start_y >= this->height)
+		return ImageViewT();
+	width = std::min(width, this->width - start_x);
+	height = std::min(height, this->height - start_y);
+	return ImageViewT(pixels + start_y * stride + start_x, width, height, stride);
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::blit(const ImageViewT& src, int x, int y)
+{
+	// Clip the source rectangle against this view once
+	const int src_x = std::max(0, -x);
+	const int src_y = std::max(0, -y);
+	const int copy_width = std::min((int)src.width, (int)width - x) - src_x;
+	const int copy_height = std::min((int)src.height, (int)height - y) - src_y;
+	if (copy_width <= 0 || copy_height <= 0)
+		return;
+
+	PixelT* dst_first = getRow(y + src_y) + x + src_x;
+	const PixelT* src_first = src.getRow(src_y) + src_x;
+	const std::less<const PixelT*> before;
+	const bool overlap = before(src_first, dst_first + (copy_height - 1) * stride + copy_width) && before(dst_first, src_first + (copy_height - 1) * src.stride + copy_width);
+	if (!overlap) {
+		parallelForRows(copy_height, [&](unsigned int row_begin, unsigned int row_end) {
+			for (unsigned int row = row_begin; row < row_end; ++row)
+				memcpy(dst_first + row * stride, src_first + row * src.stride, copy_width * sizeof(PixelT));
+		});
+		return;
+	}
+
+	//a view of the same image: serially, from the bottom when the rows move down so no row is overwritten before it is read
+	//(memmove for the rows that overlap themselves)
+	if (before(src_first, dst_first))
+		for (int row = copy_height - 1; row >= 0; --row)
+			memmove(dst_first + row * stride, src_first + row * src.stride, copy_width * sizeof(PixelT));
+	else
+		for (int row = 0; row < copy_height; ++row)
+			memmove(dst_first + row * stride, src_first + row * src.stride, copy_width * sizeof(PixelT));
+}
+
+// Writes count copies of c, past the first ones by copying what is already written in blocks that double every time,
+// so pixels of any size (like the 3 bytes of Color) are stored with the wide copies of memcpy
+template <typename PixelT>
+static void fillPixels(PixelT* row, unsigned int count, const PixelT& c)
+{
+	const unsigned int first = std::min(count, 32u);
+	std::fill(row, row + first, c);
+	for (unsigned int done = first; done < count; ) {
+		const unsigned int n = std::min(done, count - done);
+		memcpy(row + done, row, n * sizeof(PixelT));
+		done += n;
+	}
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::fill(const PixelT& c)
+{
+	//every band fills its first row and copies it to the others
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		fillPixels(getRow(y_begin), width, c);
+		for (unsigned int y = y_begin + 1; y < y_end; ++y)
+			memcpy(getRow(y), getRow(y_begin), width * sizeof(PixelT));
+	});
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::fillSpan(int x0, int x1, int y, const PixelT& c) const
+{
+	if (y < 0 || y >= (int)height)
+		return;
+	x0 = std::max(x0, 0);
+	x1 = std::min(x1, (int)width - 1);
+	if (x0 <= x1)
+		fillPixels(getRow(y) + x0, x1 - x0 + 1, c);
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::vline(int x, int y, int length, const PixelT& c) const
+{
+	if (x < 0 || x >= (int)width)
+		return;
+	const int y_end = std::min(y + length, (int)height);
+	for (int row = std::max(y, 0); row < y_end; ++row)
+		getRow(row)[x] = c;
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::fillRect(int x, int y, int w, int h, const PixelT& c) const
+{
+	const int x0 = std::max(x, 0), x1 = std::min(x + w, (int)width);
+	const int y0 = std::max(y, 0), y1 = std::min(y + h, (int)height);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	//the first row is filled, the others are copies of it
+	const PixelT* first = getRow(y0) + x0;
+	fillPixels(getRow(y0) + x0, x1 - x0, c);
+	for (int row = y0 + 1; row < y1; ++row)
+		memcpy(getRow(row) + x0, first, (x1 - x0) * sizeof(PixelT));
 }
 
-void Image::flipY()
+template <typename PixelT>
+void ImageT<PixelT>::flipX()
 {
-	for(unsigned int x = 0; x < width; ++x)
-		for(unsigned int y = 0; y < height * 0.5; ++y)
+	markModified();
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		for(unsigned int y = y_begin; y < y_end; ++y)
 		{
-			Color temp = getPixel(x, height - y - 1);
-			setPixel( x, height - y - 1, getPixel(x,y) );
-			setPixel( x, y, temp );
+			PixelT* row = getRow(y);
+			for(unsigned int x = 0; x < width / 2; ++x)
+				std::swap(row[x], row[width - x - 1]);
 		}
+	});
+}
+
+template <typename PixelT>
+void ImageT<PixelT>::flipY()
+{
+	//every task swaps a band of the top half with the mirrored band of the bottom half
+	markModified();
+	parallelForRows(height / 2, [&](unsigned int y_begin, unsigned int y_end) {
+		for(unsigned int y = y_begin; y < y_end; ++y)
+			std::swap_ranges(getRow(y), getRow(y) + width, getRow(height - y - 1));
+	});
 }
 
 
 //Loads an image from a TGA file
-bool Image::loadTGA(const char* filename)
+template <typename PixelT>
+bool ImageT<PixelT>::loadTGA(const char* filename)
 {
 	unsigned char TGAheader[12] = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 	unsigned char TGAcompare[12];
@@ -165,7 +419,7 @@ bool Image::loadTGA(const char* filename)
 	if (tgainfo->data == NULL || fread(tgainfo->data, 1, imageSize, file) != imageSize)
 	{
 		if (tgainfo->data != NULL)
-			delete tgainfo->data;
+			delete[] tgainfo->data;
             
 		fclose(file);
 		delete tgainfo;
@@ -174,37 +428,48 @@ bool Image::loadTGA(const char* filename)
 
 	fclose(file);
 
-	//save info in image
-	if(pixels)
-		delete pixels;
-
+	//save info in image (keeping the row alignment)
 	width = tgainfo->width;
 	height = tgainfo->height;
-	pixels = new Color[width*height];
+	stride = computeStride(width, row_alignment, sizeof(PixelT));
+	pixels.reset(allocatePixels<PixelT>(stride * height));
+	markModified();
 
-	//convert to float all pixels
+	//convert all pixels from BGR(A) bytes to the pixel type of the image
 	for(unsigned int y = 0; y < height; ++y)
+	{
+		PixelT* row = getRow(height - y - 1);
 		for(unsigned int x = 0; x < width; ++x)
 		{
 			unsigned int pos = y * width * bytesPerPixel + x * bytesPerPixel;
-			this->setPixel(x , height - y - 1, Color( tgainfo->data[pos+2], tgainfo->data[pos+1], tgainfo->data[pos]) );
+			const unsigned char alpha = bytesPerPixel == 4 ? tgainfo->data[pos+3] : 255;
+			convertPixel( ColorRGBA( tgainfo->data[pos+2], tgainfo->data[pos+1], tgainfo->data[pos], alpha ), row[x] );
 		}
+	}
 
-	delete tgainfo->data;
+	delete[] tgainfo->data;
 	delete tgainfo;
 
 	return true;
 }
 
 // Saves the image to a TGA file
-bool Image::saveTGA(const char* filename)
+template <typename PixelT>
+bool ImageT<PixelT>::saveTGA(const char* filename)
+{
+	return getView().saveTGA(filename);
+}
+
+// Saves the view to a TGA file
+template <typename PixelT>
+bool ImageViewT<PixelT>::saveTGA(const char* filename, bool flip_y) const
 {
 	unsigned char TGAheader[12] = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+	const unsigned int bytes_per_pixel = PixelTraits<PixelT>::has_alpha ? 4 : 3;
 
 	FILE *file = fopen(filename, "wb");
 	if ( file == NULL )
 	{
-		fclose(file);
 		return false;
 	}
 
@@ -212,8 +477,8 @@ bool Image::saveTGA(const char* filename)
 	header_short[0] = width;
 	header_short[1] = height;
 	unsigned char* header = (unsigned char*)header_short;
-	header[4] = 24;
-	header[5] = 0;
+	header[4] = bytes_per_pixel * 8;
+	header[5] = bytes_per_pixel == 4 ? 8 : 0; //bits of alpha
 
 	//tgainfo->width = header[1] * 256 + header[0];
 	//tgainfo->height = header[3] * 256 + header[2];
@@ -221,20 +486,27 @@ bool Image::saveTGA(const char* filename)
 	fwrite(TGAheader, 1, sizeof(TGAheader), file);
 	fwrite(header, 1, 6, file);
 
-	//convert pixels to unsigned char
-	unsigned char* bytes = new unsigned char[width*height*3];
+	//convert pixels to unsigned char, reading the rows in place through the stride
+	unsigned char* bytes = new unsigned char[width*height*bytes_per_pixel];
 	for(unsigned int y = 0; y < height; ++y)
+	{
+		const PixelT* row = getRow(flip_y ? y : height - y - 1);
 		for(unsigned int x = 0; x < width; ++x)
 		{
-			Color c = pixels[(height-y-1)*width+x];
-			unsigned int pos = (y*width+x)*3;
+			ColorRGBA c;
+			convertPixel(row[x], c);
+			unsigned int pos = (y*width+x)*bytes_per_pixel;
 			bytes[pos+2] = c.r;
 			bytes[pos+1] = c.g;
 			bytes[pos] = c.b;
+			if (bytes_per_pixel == 4)
+				bytes[pos+3] = c.a;
 		}
+	}
 
-	fwrite(bytes, 1, width*height*3, file);
+	fwrite(bytes, 1, width*height*bytes_per_pixel, file);
 	fclose(file);
+	delete[] bytes;
 	return true;
 }
 
@@ -308,19 +580,9 @@ void Image::screenshot(const int width, const int height, const string str)
 	if (!str.empty()) image_path = "../res/savings/Image " + string(split_time[2]) + " " + string(split_time[1]) + " " + string(split_time[4]) + " " + string(split_time[3]) + " " + str + ".tga";
 	else image_path = "../res/savings/Image " + string(split_time[2]) + " " + string(split_time[1]) + " " + string(split_time[4]) + " " + string(split_time[3]) + ".tga";
 	
-	// Create new image and fill it with the desired part of the called image
-	Image* img = new Image(width, height);
-	for (int x = 0; x <= width; x++)
-	{
-		for (int y = 0; y <= height; y++)
-		{
-			img->setPixelSafe(x, y, this->getPixelSafe(x, y));
-		}
-	}
-
-	// Flip image and save it
-	img->flipY();
-	img->saveTGA(image_path.c_str());
+	// Save the desired part of the called image straight from its pixels, flipped like the window
+	ImageView area = getView(0, 0, width, height);
+	area.saveTGA(image_path.c_str(), true);
 
 	// Notify success
 	cout << "Image successfully saved" << endl;
@@ -331,160 +593,343 @@ void Image::screenshot(const int width, const int height, const string str)
 			///////////////////  TASK 1  \\\\\\\\\\\\\\\\\\\\
 			///////////////////			 \\\\\\\\\\\\\\\\\\\\
 
-void Image::drawLine(float x0, float y0, Vector2 v, Color c) {
-	// General equation: Ax + By + C = 0
-	// B = -v.x
-	// A = v.y
-	// C = k
+// Cohen-Sutherland region of a point around a width x height rectangle
+enum { CLIP_INSIDE = 0, CLIP_LEFT = 1, CLIP_RIGHT = 2, CLIP_ABOVE = 4, CLIP_BELOW = 8 };
 
-	if (v.x == 0 && v.y == 0) {
-		setPixelSafe(x0, y0, c);
-	}
-	else {
-		float xf = x0 + v.x;
-		float yf = y0 + v.y;
+static int clipOutcode(int x, int y, int width, int height)
+{
+	int code = CLIP_INSIDE;
+	if (x < 0) code |= CLIP_LEFT;
+	else if (x >= width) code |= CLIP_RIGHT;
+	if (y < 0) code |= CLIP_ABOVE;
+	else if (y >= height) code |= CLIP_BELOW;
+	return code;
+}
 
-		//v.normalize();
-		float k = v.x * y0 - v.y * x0;
+// Steps along [0,size) of a coordinate that starts at origin and moves by step (+1 or -1) every step
+static void clipSteps(long long origin, int step, long long size, long long& begin, long long& end)
+{
+	const long long lo = step > 0 ? -origin : origin - (size - 1);
+	begin = std::max(begin, lo);
+	end = std::min(end, lo + size);
+}
 
-		if (v.x == 0) {
-			if (v.y > 0) {
-				for (double y = y0; y < yf; y += 0.0001) {
-					double x = (v.x * y - k) / v.y; // x = (-By - C)/A
-					setPixelSafe(x, y, c);
-				}
-			}
-			else {
-				for (double y = yf; y < y0; y += 0.0001) {
-					double x = (v.x * y - k) / v.y; // x = (-By - C)/A
-					setPixelSafe(x, y, c);
-				}
-			}
-		}
-		else if (v.x > 0) {
-			for (double x = x0; x < xf; x += 0.0001) {
-				double y = (v.y * x + k) / v.x; // y = (-Ax - C)/B
-				setPixelSafe(x, y, c);
-			}
+// Every pixel inside the view written once, the clipping skips whole steps of the same walk,
+// so the pixels are those of the line without clipping (a tile of a larger view draws its part of the same line)
+template <typename PixelT>
+void ImageViewT<PixelT>::drawLine(int x0, int y0, int x1, int y1, const PixelT& c, bool last) const
+{
+	const ImageViewT& view = *this;
+	if (view.isEmpty())
+		return;
+	const int code0 = clipOutcode(x0, y0, view.width, view.height);
+	const int code1 = clipOutcode(x1, y1, view.width, view.height);
+	if (code0 & code1)
+		return; //both ends on the same outer side
+
+	//one pixel per step along the major axis, the minor one advances when the error goes over 0
+	const bool steep = abs(y1 - y0) > abs(x1 - x0);
+	const long long major0 = steep ? y0 : x0, minor0 = steep ? x0 : y0;
+	const long long major_delta = (long long)(steep ? y1 : x1) - major0, minor_delta = (long long)(steep ? x1 : y1) - minor0;
+	const long long major_size = steep ? view.height : view.width, minor_size = steep ? view.width : view.height;
+	const long long dmajor = major_delta < 0 ? -major_delta : major_delta, dminor = minor_delta < 0 ? -minor_delta : minor_delta;
+	const int major_step = major_delta < 0 ? -1 : 1, minor_step = minor_delta < 0 ? -1 : 1;
+
+	//minor steps taken after i major ones: ceil((2 * dminor * i - dmajor) / (2 * dmajor)), and the first i reaching k of them
+	auto minorSteps = [&](long long i) { return dmajor ? (2 * dminor * i + dmajor - 1) / (2 * dmajor) : 0; };
+	auto firstStep = [&](long long k) { return k <= 0 ? 0 : (2 * dmajor * (k - 1) + dmajor) / (2 * dminor) + 1; };
+
+	long long begin = 0, end = dmajor + (last ? 1 : 0);
+	if (code0 | code1)
+	{
+		clipSteps(major0, major_step, major_size, begin, end);
+		long long minor_begin = 0, minor_end = dminor + 1;
+		clipSteps(minor0, minor_step, minor_size, minor_begin, minor_end);
+		if (minor_begin >= minor_end)
+			return;
+		if (dminor) {
+			begin = std::max(begin, firstStep(minor_begin));
+			end = std::min(end, firstStep(minor_end));
 		}
-		else if (v.x < 0) {
-			for (double x = xf; x < x0; x += 0.0001) {
-				double y = (v.y * x + k) / v.x; // y = (-Ax - C)/B
-				setPixelSafe(x, y, c);
-			}
+	}
+	if (begin >= end)
+		return;
+
+	const long long minor = minorSteps(begin);
+	long long error = 2 * dminor * (begin + 1) - dmajor - 2 * dmajor * minor;
+	const long long x = steep ? minor0 + minor * minor_step : major0 + begin * major_step;
+	const long long y = steep ? major0 + begin * major_step : minor0 + minor * minor_step;
+	const long long major_offset = steep ? major_step * (long long)view.stride : major_step;
+	const long long minor_offset = steep ? minor_step : minor_step * (long long)view.stride;
+	long long offset = y * view.stride + x;
+	for (long long i = begin; i < end; ++i)
+	{
+		view.pixels[offset] = c;
+		if (error > 0) { offset += minor_offset; error -= 2 * dmajor; }
+		error += 2 * dminor;
+		offset += major_offset;
+	}
+}
+
+// Marks the pixels around points as modified (margin pixels further for the anti-aliased edges)
+static void markModifiedAround(const Image& image, const Vector2* points, size_t count, float margin)
+{
+	float x_min = points[0].x, y_min = points[0].y, x_max = points[0].x, y_max = points[0].y;
+	for (size_t i = 0; i < count; ++i) {
+		if (!(fabs(points[i].x) + fabs(margin) < (1 << 24) && fabs(points[i].y) + fabs(margin) < (1 << 24))) {
+			image.markModified(); //far away or not a number, nothing precise to say
+			return;
 		}
+		x_min = std::min(x_min, points[i].x); x_max = std::max(x_max, points[i].x);
+		y_min = std::min(y_min, points[i].y); y_max = std::max(y_max, points[i].y);
+	}
+	const int x0 = (int)floor(x_min - margin) - 1, y0 = (int)floor(y_min - margin) - 1;
+	const int x1 = (int)floor(x_max + margin) + 1, y1 = (int)floor(y_max + margin) + 1;
+	image.markModified(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+void Image::drawLine(float x0, float y0, Vector2 v, Color c) {
+	drawLine((int)floor(x0), (int)floor(y0), (int)floor(x0 + v.x), (int)floor(y0 + v.y), c);
+}
+
+void Image::drawLine(int x0, int y0, int x1, int y1, Color c) {
+	markModified(std::min(x0, x1), std::min(y0, y1), abs(x1 - x0) + 1, abs(y1 - y0) + 1);
+	getView().drawLine(x0, y0, x1, y1, c);
+}
+
+void Image::drawLines(const std::vector<Vector2>& points, Color c, bool closed) {
+	if (points.empty())
+		return;
+	markModifiedAround(*this, points.data(), points.size(), 0);
+
+	//every segment leaves its end to the next one, the last one draws it unless it is the start of a closed polyline
+	const ImageView view = getView();
+	const unsigned int segments = (unsigned int)points.size() - (closed ? 0 : 1);
+	for (unsigned int i = 0; i < segments; ++i) {
+		const Vector2& a = points[i];
+		const Vector2& b = points[(i + 1) % points.size()];
+		view.drawLine((int)floor(a.x), (int)floor(a.y), (int)floor(b.x), (int)floor(b.y), c, !closed && i + 1 == segments);
 	}
+	if (segments == 0)
+		view.drawLine((int)floor(points[0].x), (int)floor(points[0].y), (int)floor(points[0].x), (int)floor(points[0].y), c);
 }
 
 
-void Image::drawRectangle(int startx, int starty, int w, int h, Color c, bool fill) {		
+void Image::drawRectangle(int startx, int starty, int w, int h, Color c, bool fill) {
 
 	int centerx = startx - w/2;
 	int centery = starty - h/2;
+	if (w <= 0 || h <= 0) return;
 
 	if (fill == true) { //fill the rectangle
-		for (int x  = centerx; x < centerx + w; ++x) {
-			for (int y = centery; y < centery + h; ++y) {
-				setPixelSafe(x, y, c); 
-			}
-		}
+		fillRect(centerx, centery, w, h, c);
 	}
-	else { //draw only the border
-
-		for (int x = centerx; x < (centerx + w); ++x) // Horizontal edges
-		{
-			setPixelSafe(x, centery, c);
-			setPixelSafe(x, centery + h - 1, c);
-		}
-		for (int y = centery; y < centery + h; ++y) // Vertical edges
-		{
-			setPixelSafe(centerx, y, c);
-			setPixelSafe(centerx + w, y, c);
-		}
+	else { //draw only the border, the corners belong to the horizontal edges
+		hline(centerx, centery, w, c); // Horizontal edges
+		if (h > 1) hline(centerx, centery + h - 1, w, c);
+		vline(centerx, centery + 1, h - 2, c); // Vertical edges
+		if (w > 1) vline(centerx + w - 1, centery + 1, h - 2, c);
 	}
 }
 
 void Image::drawCircle(int a, int b, int r, Color c, bool fill) {
-	for (double x = -r; x <= r; x++) {
-		for (double y = -r; y <= r; y++) {
-			double theta = atan2(y, x);
-			if (fill == true) {
-				if (abs(x) <= abs(r * cos(theta)) && abs(y) <= abs(r * sin(theta))) {
-					setPixelSafe(x + a,y + b,c);
-				}
-			}
+	drawEllipse(a, b, r, r, c, fill);
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::drawEllipse(int cx, int cy, int rx, int ry, const PixelT& c, bool fill) const
+{
+	if (rx < 0 || ry < 0)
+		return;
+	const ImageViewT& view = *this;
+
+	//midpoint test: (x,y) is inside when (x / (rx + 1/2))^2 + (y / (ry + 1/2))^2 <= 1, in integers
+	const long long a = (2LL * rx + 1) * (2LL * rx + 1), b = (2LL * ry + 1) * (2LL * ry + 1);
+	auto inside = [&](long long x, long long y) { return 4 * x * x * b + 4 * y * y * a <= a * b; };
+
+	//half width of every row from the centre one, each one found by moving the edge of the previous one inwards
+	int half = rx;
+	for (int y = 0; y <= ry; ++y)
+	{
+		int next = -1;
+		if (y < ry)
+			for (next = half; next > 0 && !inside(next, y + 1); --next);
+
+		//the outline of a row goes from the edge of the next one to its own, so it is closed and no pixel is drawn twice
+		const int from = fill ? 0 : std::min(next + 1, half);
+		for (int row = cy - y; row <= cy + y; row += 2 * y)
+		{
+			if (from == 0)
+				view.fillSpan(cx - half, cx + half, row, c);
 			else {
-				if (x == round(r * cos(theta)) && y == round(r * sin(theta))) {
-					setPixelSafe(x + a, y + b, c);
-				}
+				view.fillSpan(cx - half, cx - from, row, c);
+				view.fillSpan(cx + from, cx + half, row, c);
 			}
+			if (y == 0)
+				break;
 		}
+		half = next;
 	}
+}
 
+void Image::drawEllipse(int cx, int cy, int rx, int ry, Color c, bool fill) {
+	markModified(cx - rx, cy - ry, 2 * rx + 1, 2 * ry + 1);
+	getView().drawEllipse(cx, cy, rx, ry, c, fill);
+}
+
+void Image::drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, Color c, bool fill) {
+	if (fill == true) {
+		const Vector2 points[3] = { p0, p1, p2 };
+		markModifiedAround(*this, points, 3, 0);
+		fillTriangle(getView(), p0, p1, p2, c);
+	}
+	else {
+		std::vector<Vector2> points = { p0, p1, p2 };
+		drawLines(points, c, true);
+	}
+}
+
+void Image::drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, Color c0, Color c1, Color c2) {
+	const Vector2 points[3] = { p0, p1, p2 };
+	markModifiedAround(*this, points, 3, 0);
+	fillTriangle(getView(), p0, p1, p2, c0, c1, c2);
+}
+
+void Image::drawPolygon(const std::vector<Vector2>& points, Color c, bool fill) {
+	if (fill == true) {
+		if (!points.empty())
+			markModifiedAround(*this, points.data(), points.size(), 0);
+		fillPolygon(getView(), points, c);
+	}
+	else
+		drawLines(points, c, true);
+}
+
+void Image::drawLineAA(const Vector2& p0, const Vector2& p1, Color c) {
+	const Vector2 points[2] = { p0, p1 };
+	markModifiedAround(*this, points, 2, 1);
+	strokeLineAA(getView(), p0, p1, c);
+}
+
+void Image::drawCircleAA(const Vector2& center, float r, Color c, bool fill) {
+	markModifiedAround(*this, &center, 1, r + 1);
+	if (fill == true)
+		fillCircleAA(getView(), center, r, c);
+	else
+		strokeCircleAA(getView(), center, r, c);
+}
+
+void Image::drawRectangleAA(float x, float y, float w, float h, Color c, bool fill) {
+	if (w < 0) { x += w; w = -w; }
+	if (h < 0) { y += h; h = -h; }
+	const Vector2 corners[2] = { Vector2(x, y), Vector2(x + w, y + h) };
+	markModifiedAround(*this, corners, 2, 1);
+	if (fill == true || w <= 2 || h <= 2) {
+		fillRectAA(getView(), x, y, w, h, c);
+		return;
+	}
+
+	// Border 1 pixel wide inside the rectangle, the corners belong to the horizontal edges
+	fillRectAA(getView(), x, y, w, 1, c);
+	fillRectAA(getView(), x, y + h - 1, w, 1, c);
+	fillRectAA(getView(), x, y + 1, 1, h - 2, c);
+	fillRectAA(getView(), x + w - 1, y + 1, 1, h - 2, c);
+}
+
+void Image::drawPolygonAA(const std::vector<Vector2>& points, Color c, bool fill) {
+	if (points.empty())
+		return;
+	markModifiedAround(*this, points.data(), points.size(), 1);
+	if (fill == true) {
+		fillPolygonAA(getView(), points, c);
+		return;
+	}
+	if (points.size() == 2)
+		strokeLineAA(getView(), points[0], points[1], c);
+	else
+		for (size_t i = 0; i < points.size(); ++i)
+			strokeLineAA(getView(), points[i], points[(i + 1) % points.size()], c);
 }
 
 			///////////////////          \\\\\\\\\\\\\\\\\\\\
 			///////////////////  TASK 2  \\\\\\\\\\\\\\\\\\\\
 			///////////////////			 \\\\\\\\\\\\\\\\\\\\
 
+// Range [first, last] of the pattern coordinates 0..size that fall inside the image (0..limit-1) once moved by offset
+static bool clipPatternRange(int size, int offset, int limit, int& first, int& last)
+{
+	first = std::max(0, -offset);
+	last = std::min(size, limit - 1 - offset);
+	return first <= last;
+}
+
 void Image::drawGradient(int w, int h) {
-	for (int x = 0; x < w; x++) {
-		for (int y = 0; y < h; y++) {
-			float f = x / (float)w;
-			f = f * 255;
-			setPixelSafe(x, y, Color(f, 0, 255 - f));
-		}
+	// Clip to the image
+	const int max_x = std::min(w, (int)width);
+	const int max_y = std::min(h, (int)height);
+	if (max_x <= 0 || max_y <= 0) return;
+
+	// The colour only depends on x, so the first row is computed and copied to the others
+	markModified();
+	Color* first = getRow(0);
+	for (int x = 0; x < max_x; x++) {
+		float f = x / (float)w;
+		f = f * 255;
+		first[x] = Color(f, 0, 255 - f);
 	}
+	parallelForRows(max_y - 1, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin + 1; y <= y_end; y++)
+			memcpy(getRow(y), getRow(0), max_x * sizeof(Color));
+	});
 }
 
 void Image::drawNotchGradient(int w, int h) {
 	double diagonal = sqrt(pow((w / 2), 2) + pow(h / 2, 2));
-	for (int x = 0; x < w; x++) {
-		for (int y = 0; y < h; y++) {
-			int x_diff = abs((int)width / 2 - x);
-			int y_diff = abs((int)height / 2 - y);
-			double radius = sqrt(pow(x_diff, 2) + pow(y_diff, 2));
-			double color_degree = 255 * radius / diagonal;
-			setPixelSafe(x, y, Color(color_degree, color_degree, color_degree));
+	const int max_x = std::min(w, (int)width);
+	const int max_y = std::min(h, (int)height);
+	if (max_x <= 0 || max_y <= 0) return;
+
+	markModified();
+	parallelForRows(max_y, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; y++) {
+			Color* row = getRow(y);
+			for (int x = 0; x < max_x; x++) {
+				int x_diff = abs((int)width / 2 - x);
+				int y_diff = abs((int)height / 2 - (int)y);
+				double radius = sqrt(pow(x_diff, 2) + pow(y_diff, 2));
+				double color_degree = 255 * radius / diagonal;
+				row[x] = Color(color_degree, color_degree, color_degree);
+			}
 		}
-	}
+	});
 }
 
 void Image::drawCheckedFrame() {
-	fill(Color::BLACK);
-
 	// Lines constants
 	int const line_thickness = 10;
 	int const line_space = 20;
-
-	// Horizontal blue lines
-	for (int aux = 0; aux <= height; aux += (line_space + 10)) {
-		for (int y = aux; y < aux + line_thickness; y++) {
-			for (int x = 0; x < width; x++) {
-				setPixelSafe(x, y, Color(0, 0, 255));
-			}
-		}
-	}
-
-	// Vertical red lines
-	for (int aux = 0; aux <= width; aux += (line_space + 10)) {
-		for (int x = aux; x < aux + line_thickness; x++) {
-			for (int y = 0; y < height; y++) {
-				setPixelSafe(x, y, Color(255, 0, 0));
-			}
-		}
+	int const period = line_space + line_thickness;
+	if (width == 0 || height == 0) return;
+
+	// A row either crosses a horizontal blue line (pink at the crossings) or not (red vertical lines over black)
+	// Both kinds are built once with spans and every row of the image is a copy of one of them
+	std::vector<Color> line_row(width), space_row(width);
+	const ImageView line_view(line_row.data(), width, 1, width);
+	const ImageView space_view(space_row.data(), width, 1, width);
+	line_view.hline(0, 0, width, Color(0, 0, 255));
+	space_view.hline(0, 0, width, Color::BLACK);
+	for (int x = 0; x < (int)width; x += period) {
+		line_view.hline(x, 0, line_thickness, Color(255, 0, 255));
+		space_view.hline(x, 0, line_thickness, Color(255, 0, 0));
 	}
 
-	// Pink squares
-	for (int aux = 0; aux <= height; aux += (line_space + 10)) {
-		for (int aux2 = 0; aux2 <= width; aux2 += (line_space + 10)) {
-			for(int y = aux; y < aux + line_thickness; y++){
-				for (int x = aux2; x < aux2 + line_thickness; x++) {
-					setPixelSafe(x, y, Color(255, 0, 255));
-				}
-			}
+	markModified();
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; y++) {
+			const bool horizontal_line = (y % period) < line_thickness;
+			memcpy(getRow(y), horizontal_line ? line_row.data() : space_row.data(), width * sizeof(Color));
 		}
-	}
+	});
 }
 
 void Image::drawBilinearInterpolation(const int width, const int height, const int window_width, const int window_height)
@@ -506,26 +951,46 @@ void Image::drawBilinearInterpolation(const int width, const int height, const i
 		Vector3(255, 255, 0) // top right corner -> YELLOW
 	};
 
-	// Iterate over the pixels of the image
-	for (int x = 0; x <= width; x++) {
-		for (int y = 0; y <= height; y++) {
+	// Visible part of the pattern
+	int x_first, x_last, y_first, y_last;
+	if (!clipPatternRange(width, x_offset, this->width, x_first, x_last) || !clipPatternRange(height, y_offset, this->height, y_first, y_last))
+		return;
+
+	// The colour only changes from one step of the grid to the next, so the pixels of a step along each axis are found first
+	struct Run { int first, last; float step; };
+	auto findRuns = [&](int first, int last, float size) {
+		std::vector<Run> runs;
+		for (int i = first; i <= last; i++) {
 
 			// Find the current step in the grid and map it to the range [0, 1]
-			Vector2 current_step
-			(
-				clamp(floor(x / step_size.x) / (num_steps - 1), 0, 1), 
-				clamp(floor(y / step_size.y) / (num_steps - 1), 0, 1)
-			);
-
-			// Bilinear interpolation
-			const Vector3 x_bottom_color = vertex_colors[1] * (1 - current_step.x) + vertex_colors[2] * current_step.x;
-			const Vector3 x_top_color = vertex_colors[0] * (1 - current_step.x) + vertex_colors[3] * current_step.x;
-			const Vector3 bilinear_color = x_bottom_color * (1 - current_step.y) + x_top_color * current_step.y;
-
-			// Assing pixel color
-			setPixelSafe(x + x_offset, y + y_offset, Color(bilinear_color.x, bilinear_color.y, bilinear_color.z));
+			const float step = clamp(floor(i / size) / (num_steps - 1), 0, 1);
+			if (runs.empty() || runs.back().step != step) runs.push_back({ i, i, step });
+			else runs.back().last = i;
 		}
-	}	
+		return runs;
+	};
+	const std::vector<Run> columns = findRuns(x_first, x_last, step_size.x);
+	const std::vector<Run> rows = findRuns(y_first, y_last, step_size.y);
+
+	// Every cell of the grid is a rectangle of a single colour
+	markModified();
+	const ImageView view = getView();
+	parallelForRows(rows.size(), [&](unsigned int row_begin, unsigned int row_end) {
+		for (unsigned int j = row_begin; j < row_end; j++) {
+			for (const Run& column : columns) {
+				const Vector2 current_step(column.step, rows[j].step);
+
+				// Bilinear interpolation
+				const Vector3 x_bottom_color = vertex_colors[1] * (1 - current_step.x) + vertex_colors[2] * current_step.x;
+				const Vector3 x_top_color = vertex_colors[0] * (1 - current_step.x) + vertex_colors[3] * current_step.x;
+				const Vector3 bilinear_color = x_bottom_color * (1 - current_step.y) + x_top_color * current_step.y;
+
+				// Assing cell color
+				view.fillRect(column.first + x_offset, rows[j].first + y_offset, column.last - column.first + 1, rows[j].last - rows[j].first + 1,
+					Color(bilinear_color.x, bilinear_color.y, bilinear_color.z));
+			}
+		}
+	});
 }
 
 void Image::drawSinusoidGradient(const int width, const int height, const int window_width, const int window_height)
@@ -534,20 +999,29 @@ void Image::drawSinusoidGradient(const int width, const int height, const int wi
 	const int x_offset = (window_width - width) / 2;
 	const int y_offset = (window_height - height) / 2;
 
-	// Iterate over the pixels of the image
-	for (int x = 0; x <= width; x++) {
-		
-		// Normalize x coordinate to work in normal space
-		float normal_x = x / (float)width;
+	// Visible part of the pattern
+	int x_first, x_last, y_first, y_last;
+	if (!clipPatternRange(width, x_offset, this->width, x_first, x_last) || !clipPatternRange(height, y_offset, this->height, y_first, y_last))
+		return;
 
-		// Sinus attributes
-		const float amplitude = 0.15;
-		const float offset = 0.5;
+	// Sinus attributes
+	const float amplitude = 0.15;
+	const float offset = 0.5;
 
-		// Compute sinus value
-		const float sin_val = amplitude * sin(2 * PI * normal_x) + offset;
+	// Compute sinus value of every column once
+	std::vector<float> sin_values(width + 1);
+	for (int x = x_first; x <= x_last; x++) {
 
-		for (int y = 0; y <= height; y++) {
+		// Normalize x coordinate to work in normal space
+		float normal_x = x / (float)width;
+		sin_values[x] = amplitude * sin(2 * PI * normal_x) + offset;
+	}
+
+	// Iterate over the pixels of the image
+	markModified();
+	parallelForRows(y_last - y_first + 1, [&](unsigned int row_begin, unsigned int row_end) {
+		for (int y = y_first + row_begin; y < y_first + (int)row_end; y++) {
+			Color* row = getRow(y + y_offset);
 
 			// Normalize y coordinate to work in normal space
 			float normal_y = y / (float)height;
@@ -555,11 +1029,14 @@ void Image::drawSinusoidGradient(const int width, const int height, const int wi
 			// Y-axis linear interpolation
 			float range_size = 230; // In order to resemble better the suggested photo and visualize better the borders we don't use the full range.
 			float f = range_size * normal_y; // Interpolation factor
-			
-			// Magic
-			normal_y > sin_val ? setPixelSafe(x + x_offset, y + y_offset, Color(0, 1 - f, 0)) : setPixelSafe(x + x_offset, y + y_offset, Color(0, f, 0));
+
+			for (int x = x_first; x <= x_last; x++) {
+
+				// Magic
+				row[x + x_offset] = normal_y > sin_values[x] ? Color(0, 1 - f, 0) : Color(0, f, 0);
+			}
 		}
-	}
+	});
 
 }
 
@@ -572,76 +1049,247 @@ void Image::drawChessBoard(const int width, const int height, const int window_w
 	// Define grid parameters
 	const int square_size = 30; // pixels
 
-	// Iterate over the pixels of the image
-	for (int x = 0; x <= width; x++) {
-		for (int y = 0; y <= height; y++) {
+	// Visible part of the pattern
+	int x_first, x_last, y_first, y_last;
+	if (!clipPatternRange(width, x_offset, this->width, x_first, x_last) || !clipPatternRange(height, y_offset, this->height, y_first, y_last))
+		return;
+
+	// The rows are of two kinds, starting with a white or a black square: both are built once with spans
+	// and every row of the pattern is a copy of one of them
+	const int visible = x_last - x_first + 1;
+	std::vector<Color> row_kinds[2] = { std::vector<Color>(visible), std::vector<Color>(visible) };
+	for (int kind = 0; kind < 2; kind++) {
+		const ImageView row(row_kinds[kind].data(), visible, 1, visible);
+		for (int x = x_first - x_first % square_size; x <= x_last; x += square_size) {
 
 			// Find the current step in the grid
-			const int current_square = floor(x / square_size) + floor(y / square_size);
+			const int current_square = x / square_size + kind;
 
 			// Magic
-			current_square % 2 == 0 ? setPixelSafe(x + x_offset, y + y_offset, Color::WHITE) : setPixelSafe(x + x_offset, y + y_offset, Color::BLACK);
+			row.hline(x - x_first, 0, square_size, current_square % 2 == 0 ? Color::WHITE : Color::BLACK);
 		}
 	}
 
+	markModified();
+	parallelForRows(y_last - y_first + 1, [&](unsigned int row_begin, unsigned int row_end) {
+		for (int y = y_first + row_begin; y < y_first + (int)row_end; y++)
+			memcpy(getRow(y + y_offset) + x_first + x_offset, row_kinds[(y / square_size) % 2].data(), visible * sizeof(Color));
+	});
+
 }
 
 			///////////////////          \\\\\\\\\\\\\\\\\\\\
 			///////////////////  TASK 3  \\\\\\\\\\\\\\\\\\\\
 			///////////////////			 \\\\\\\\\\\\\\\\\\\\
 
-void Image::grayscale() 
+// The filters of ImageT work on a view of the whole image, so any region can be filtered in place
+
+template <typename PixelT> void ImageT<PixelT>::grayscale() { markModified(); getView().grayscale(); }
+template <typename PixelT> void ImageT<PixelT>::threshold() { markModified(); getView().threshold(); }
+template <typename PixelT> void ImageT<PixelT>::invert() { markModified(); getView().invert(); }
+template <typename PixelT> void ImageT<PixelT>::channelManipulation() { markModified(); getView().channelManipulation(); }
+template <typename PixelT> void ImageT<PixelT>::blur() { markModified(); getView().blur(); }
+template <typename PixelT> void ImageT<PixelT>::fade() { markModified(); getView().fade(); }
+template <typename PixelT> void ImageT<PixelT>::boxFilter(unsigned int radius) { markModified(); getView().boxFilter(radius); }
+template <typename PixelT> void ImageT<PixelT>::adaptiveThreshold(unsigned int radius, float offset) { markModified(); getView().adaptiveThreshold(radius, offset); }
+template <typename PixelT> void ImageT<PixelT>::draw(const DrawListT<PixelT>& list) { markModified(); list.execute(getView()); }
+
+// Generic point filters working per channel, for the pixel types without vectorized kernels
+
+template <typename PixelT>
+static void grayscaleSpan(PixelT* pixels, unsigned int count)
 {
-	for (int x = 0; x < width; x++) {
-		for (int y = 0; y < height; y++) {
-			Color c = getPixel(x, y);
-			double color_degree = ((double)c.r / 255 + (double)c.g / 255 + (double)c.b / 255)/3.0 * 255.0;
-			c.set(color_degree, color_degree, color_degree);
-			setPixel(x, y, c);
-		}
+	typedef PixelTraits<PixelT> Traits;
+	for (unsigned int j = 0; j < count; ++j) {
+		PixelT& c = pixels[j];
+		typename Traits::Accumulator sum = 0;
+		for (unsigned int i = 0; i < Traits::color_channels; ++i)
+			sum += c.v[i];
+		const typename Traits::Channel gray = (typename Traits::Channel)(sum / (typename Traits::Accumulator)Traits::color_channels);
+		for (unsigned int i = 0; i < Traits::color_channels; ++i)
+			c.v[i] = gray;
 	}
 }
 
-void Image::threshold() 
+//white when the mean of the channels is above half the range
+template <typename PixelT>
+static void thresholdSpan(PixelT* pixels, unsigned int count)
 {
-	for (int x = 0; x < width; x++) {
-		for (int y = 0; y < height; y++) {
-			Color c = getPixel(x, y);
-			double color_degree = ((double)c.r / 255 + (double)c.g / 255 + (double)c.b / 255) / 3.0 * 255.0;
-			if (color_degree > 127) {color_degree = 255;}
-			else {color_degree = 0;}
-			c.set(color_degree, color_degree, color_degree);
-			setPixel(x, y, c);
-		}
+	typedef PixelTraits<PixelT> Traits;
+	typedef typename Traits::Accumulator Accumulator;
+	const Accumulator limit = (Accumulator)Traits::color_channels * ((Accumulator)Traits::maxValue() / 2);
+	for (unsigned int j = 0; j < count; ++j) {
+		PixelT& c = pixels[j];
+		Accumulator sum = 0;
+		for (unsigned int i = 0; i < Traits::color_channels; ++i)
+			sum += c.v[i];
+		const typename Traits::Channel value = sum > limit ? Traits::maxValue() : 0;
+		for (unsigned int i = 0; i < Traits::color_channels; ++i)
+			c.v[i] = value;
 	}
 }
 
-void Image::invert() 
+template <typename PixelT>
+static void invertSpan(PixelT* pixels, unsigned int count)
 {
-	for (int x = 0; x < width; x++) {
-		for (int y = 0; y < height; y++) {
-			Color c = getPixel(x, y);
-			c.set(255 - c.r, 255 - c.g, 255 - c.b);
-			setPixel(x, y, c);
-		}
+	typedef PixelTraits<PixelT> Traits;
+	for (unsigned int j = 0; j < count; ++j)
+		for (unsigned int i = 0; i < Traits::color_channels; ++i)
+			pixels[j].v[i] = Traits::maxValue() - pixels[j].v[i];
+}
+
+// c.set(c.b,c.g,c.r);
+// c.set(c.r * 2, c.g / 2, c.b / 2);
+template <typename PixelT>
+static void channelManipulationSpan(PixelT* pixels, unsigned int count)
+{
+	typedef PixelTraits<PixelT> Traits;
+	for (unsigned int j = 0; j < count; ++j) {
+		PixelT& c = pixels[j];
+		c.v[0] = Traits::fromFloat((float)((typename Traits::Accumulator)c.v[0] * 2));
+		for (unsigned int i = 1; i < Traits::color_channels; ++i)
+			c.v[i] = Traits::fromFloat((float)(c.v[i] / 2));
 	}
 }
 
-void Image::channelManipulation() 
+// channelManipulation of 8 bit pixels is a per channel lookup (see lut.h), the tables are built once
+static const ChannelLUT& getChannelManipulationLUT()
 {
-	for (int x = 0; x < width; x++) {
-		for (int y = 0; y < height; y++) {
-			Color c = getPixel(x, y);
-			// c.set(c.b,c.g,c.r);
-			c.set(c.r * 2, c.g / 2, c.b / 2);
-			setPixelSafe(x, y, c);
-		}
+	static const ChannelLUT lut = ChannelLUT::channelManipulation();
+	return lut;
+}
+
+static void channelManipulationLUT(Color* pixels, unsigned int count)
+{
+	getChannelManipulationLUT().apply(pixels, count);
+}
+
+static void channelManipulationLUTRGBA(ColorRGBA* pixels, unsigned int count)
+{
+	static const ChannelLUT::WideTables wide = getChannelManipulationLUT().getWideTables();
+	ChannelLUT::apply(pixels, count, wide);
+}
+
+// Point filters of every pixel type, the vectorized ones (see simd.h) when there are
+template <typename PixelT>
+struct SpanKernels
+{
+	typedef void (*Kernel)(PixelT* pixels, unsigned int count);
+	static Kernel grayscale() { return grayscaleSpan<PixelT>; }
+	static Kernel threshold() { return thresholdSpan<PixelT>; }
+	static Kernel invert() { return invertSpan<PixelT>; }
+	static Kernel channelManipulation() { return channelManipulationSpan<PixelT>; }
+};
+
+template <>
+struct SpanKernels<Color>
+{
+	typedef void (*Kernel)(Color* pixels, unsigned int count);
+	static Kernel grayscale() { return getPixelKernels().grayscale; }
+	static Kernel threshold() { return getPixelKernels().threshold; }
+	static Kernel invert() { return getPixelKernels().invert; }
+	static Kernel channelManipulation() { return channelManipulationLUT; }
+};
+
+template <>
+struct SpanKernels<ColorRGBA>
+{
+	typedef void (*Kernel)(ColorRGBA* pixels, unsigned int count);
+	static Kernel grayscale() { return getPixelKernels().grayscaleRGBA; }
+	static Kernel threshold() { return getPixelKernels().thresholdRGBA; }
+	static Kernel invert() { return getPixelKernels().invertRGBA; }
+	static Kernel channelManipulation() { return channelManipulationLUTRGBA; }
+};
+
+// Point filters are single step pipelines
+template <typename PixelT> void ImageViewT<PixelT>::grayscale() { FilterPipelineT<PixelT>().grayscale().apply(*this); }
+template <typename PixelT> void ImageViewT<PixelT>::threshold() { FilterPipelineT<PixelT>().threshold().apply(*this); }
+template <typename PixelT> void ImageViewT<PixelT>::invert() { FilterPipelineT<PixelT>().invert().apply(*this); }
+template <typename PixelT> void ImageViewT<PixelT>::channelManipulation() { FilterPipelineT<PixelT>().channelManipulation().apply(*this); }
+
+template <typename PixelT>
+FilterPipelineT<PixelT>& FilterPipelineT<PixelT>::grayscale()
+{
+	//gray images, or pixels already gray after a threshold or a grayscale, stay the same
+	const FilterOperation last = getLastOperation();
+	if (PixelTraits<PixelT>::color_channels == 1 || last == FILTER_GRAYSCALE || last == FILTER_THRESHOLD)
+		return *this;
+	return push(FILTER_GRAYSCALE, SpanKernels<PixelT>::grayscale());
+}
+
+template <typename PixelT>
+FilterPipelineT<PixelT>& FilterPipelineT<PixelT>::threshold()
+{
+	//thresholding twice gives the same result
+	if (getLastOperation() == FILTER_THRESHOLD)
+		return *this;
+	return push(FILTER_THRESHOLD, SpanKernels<PixelT>::threshold());
+}
+
+template <typename PixelT>
+FilterPipelineT<PixelT>& FilterPipelineT<PixelT>::invert()
+{
+	//two inverts cancel each other (only exactly with integer channels)
+	if (getLastOperation() == FILTER_INVERT && std::numeric_limits<typename PixelTraits<PixelT>::Channel>::is_integer) {
+		operations.pop_back();
+		return *this;
 	}
+	return push(FILTER_INVERT, SpanKernels<PixelT>::invert());
+}
+
+template <typename PixelT>
+FilterPipelineT<PixelT>& FilterPipelineT<PixelT>::channelManipulation()
+{
+	return push(FILTER_CHANNEL_MANIPULATION, SpanKernels<PixelT>::channelManipulation());
+}
+
+template <typename PixelT>
+FilterPipelineT<PixelT>& FilterPipelineT<PixelT>::add(SpanFunction function)
+{
+	return push(FILTER_CUSTOM, function);
+}
+
+template <typename PixelT>
+FilterPipelineT<PixelT>& FilterPipelineT<PixelT>::push(FilterOperation type, SpanFunction function)
+{
+	Operation operation = { type, function };
+	operations.push_back(operation);
+	return *this;
+}
+
+// Runs every operation over a span, a tile of at most TILE_BYTES at a time so it stays in the L1 cache between operations
+template <typename PixelT>
+void FilterPipelineT<PixelT>::applySpan(PixelT* pixels, unsigned int count) const
+{
+	const unsigned int tile = std::max(1u, (unsigned int)(TILE_BYTES / sizeof(PixelT)));
+	for (unsigned int start = 0; start < count; start += tile) {
+		const unsigned int n = std::min(tile, count - start);
+		for (unsigned int i = 0; i < operations.size(); ++i)
+			operations[i].function(pixels + start, n);
+	}
+}
+
+template <typename PixelT>
+void FilterPipelineT<PixelT>::apply(const ImageViewT<PixelT>& view) const
+{
+	if (operations.empty() || view.isEmpty())
+		return;
+
+	parallelForRows(view.height, [&](unsigned int y_begin, unsigned int y_end) {
+		if (view.isContiguous())
+			applySpan(view.getRow(y_begin), (y_end - y_begin) * view.width);
+		else
+			for (unsigned int y = y_begin; y < y_end; ++y)
+				applySpan(view.getRow(y), view.width);
+	});
 }
 
 
 void Image::tryAllSwaps()
 {
+	// Channel every possibility copies: black, red, blue and green
+	const int sources[4] = { -1, 0, 2, 1 };
+
 	for (int i = 0; i < 4; i++)
 	{
 		for (int j = 0; j < 4; j++)
@@ -649,26 +1297,10 @@ void Image::tryAllSwaps()
 			for (int k = 0; k < 4; k++)
 			{
 				// Create a copy of the image to manipulate
-				Image* img = new Image(*this);
-
-				// Set the pixel colors of the copy as desired
-				for (int x = 0; x < img->width; x++)
-				{
-					for (int y = 0; y < img->height; y++)
-					{
-						// Get image pixel color
-						Color c = img->getPixelSafe(x, y);
-						
-						// Declare all possibilities
-						float p[4] = { 0, c.r, c.b, c.g };
-
-						// Set color upon possibilities
-						c.set(p[i], p[j], p[k]);
-
-						// Set color to copy
-						img->setPixelSafe(x, y, c);
-					}
-				}
+				Image img(*this);
+
+				// Set the pixel colors of the copy as desired, one table lookup per channel
+				ChannelLUT::permutation(sources[i], sources[j], sources[k]).apply(img.getView());
 
 				// Get combination string
 				ostringstream ss;
@@ -676,46 +1308,87 @@ void Image::tryAllSwaps()
 				string combination(ss.str());
 
 				// Save copy in local storage
-				img->screenshot(img->width, img->height, combination);
+				img.screenshot(img.width, img.height, combination);
 
 			}
 		}
 	}	
 }
 
-void Image::blur() {
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			Color c1 = getPixel(x, y);
-			Color c2 = getPixel(x + 1, y);
-			Color c3 = getPixel(x + 2, y);
-			Color c4 = getPixel(x + 3, y);
-			Color c5 = getPixel(x + 4, y);
-			Color c6 = getPixel(x + 5, y);
-			Color c7 = getPixel(x + 6, y);
-			Color c = Color(
-				(c1.r + c2.r + c3.r + c4.r + c5.r + c6.r + c7.r) / 7, // RED
-				(c1.g + c2.g + c3.g + c4.g + c5.g + c6.g + c7.g) / 7, // GREEN
-				(c1.b + c2.b + c3.b + c4.b + c5.b + c6.b + c7.b) / 7 // BLUE
-			);
-			setPixel(x, y, c);
-		}
-	}
+// 7x7 box blur with clamped edges (see blur.h)
+template <typename PixelT>
+static SeparableBlurT<PixelT> createBoxBlur(unsigned int radius)
+{
+	SeparableBlurT<PixelT> blur;
+	blur.setBox(radius, radius);
+	return blur;
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::blur() {
+	//one per thread, so its scratch image is allocated once and not at every call
+	static thread_local SeparableBlurT<PixelT> blur = createBoxBlur<PixelT>(3);
+	blur.apply(*this);
 }
 
-void Image::fade() {
+template <typename PixelT>
+void ImageViewT<PixelT>::fade() {
+	typedef PixelTraits<PixelT> Traits;
+
 	double const diagonal = sqrt(pow((width / 2), 2) + pow(height / 2, 2));
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			int x_diff = abs((int)width/2 - x);
-			int y_diff = abs((int)height / 2 - y);
-			double radius = sqrt(pow(x_diff,2) + pow(y_diff,2));
-			double color_degree = 4*radius / diagonal + 0.25;
-			Color c = getPixel(x, y);
-			c.set(c.r/color_degree,c.g/color_degree,c.b/color_degree);
-			setPixel(x, y, c);
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				int x_diff = abs((int)width/2 - (int)x);
+				int y_diff = abs((int)height / 2 - (int)y);
+				double radius = sqrt(pow(x_diff,2) + pow(y_diff,2));
+				double color_degree = 4*radius / diagonal + 0.25;
+				PixelT& c = getPixelRef(x, y);
+				for (unsigned int i = 0; i < Traits::color_channels; ++i)
+					c.v[i] = Traits::fromFloat((float)(c.v[i] / color_degree));
+			}
 		}
-	}
+	});
+}
+
+template <typename PixelT>
+void ImageViewT<PixelT>::boxFilter(unsigned int radius) {
+	typedef PixelTraits<PixelT> Traits;
+	const float rounding = std::numeric_limits<typename Traits::Channel>::is_integer ? 0.5f : 0.0f;
+	const IntegralImageT<PixelT> integral(*this, false);
+	const int size = 2 * radius + 1;
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y) {
+			PixelT* row = getRow(y);
+			for (unsigned int x = 0; x < width; ++x)
+				for (unsigned int c = 0; c < Traits::color_channels; ++c)
+					row[x].v[c] = Traits::fromFloat((float)integral.getMean((int)x - (int)radius, (int)y - (int)radius, size, size, c) + rounding);
+		}
+	});
+}
+
+// Like threshold() but against the mean brightness of the window around every pixel instead of half the range
+template <typename PixelT>
+void ImageViewT<PixelT>::adaptiveThreshold(unsigned int radius, float offset) {
+	typedef PixelTraits<PixelT> Traits;
+	const IntegralImageT<PixelT> integral(*this, false);
+	const int size = 2 * radius + 1;
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y) {
+			PixelT* row = getRow(y);
+			for (unsigned int x = 0; x < width; ++x) {
+				//brightness as the sum of the channels, like threshold()
+				double local = 0, value = 0;
+				for (unsigned int c = 0; c < Traits::color_channels; ++c) {
+					local += integral.getMean((int)x - (int)radius, (int)y - (int)radius, size, size, c);
+					value += row[x].v[c];
+				}
+				const typename Traits::Channel result = value > local - offset * Traits::color_channels ? Traits::maxValue() : 0;
+				for (unsigned int c = 0; c < Traits::color_channels; ++c)
+					row[x].v[c] = result;
+			}
+		}
+	});
 }
 
 
@@ -724,48 +1397,23 @@ void Image::fade() {
 			///////////////////			 \\\\\\\\\\\\\\\\\\\\
 
 
+// Rotates img by beta around the centre of the framebuffer (the border pixels of img repeat outside it)
 void Image::rotate(Image* img, double beta) {
-	for (int xf = 0; xf < width; xf++) { 
-		for (int yf = 0; yf < height; yf++) {
-
-			// Distancia horizontal respecto al centro del framebuffer
-			double xf_aux = (double)xf - width / 2; 
-
-			// Distancia vertical respecto al centro del framebuffer
-			double yf_aux = (double)yf - height / 2; 
-
-			// Coordenadas horizontales del pxel de la imagen que corresponde a la posicin (xf_aux,yf_aux) del framebuffer
-			double xi = xf_aux * cos(beta) + yf_aux * sin(beta); 
-
-			//Coordenadas verticales del pxel de la imagen que corresponde a la posicin (xf_aux,yf_aux) del framebuffer
-			double yi = yf_aux * cos(beta) - xf_aux * sin(beta); 
-			
-			//Una vez calculada la direccin, cogemos el pxel en funcin del origen de coordenadas (0,0) de la imagen
-			xi += width / 2; // Sumamos para volver a centrar en el origen de coordenadas
-			yi += height / 2; // Sumamos para volver a centrar en el origen de coordenadas
-
-			// Color del pxel (xi,yi) de la imagen
-			Color c = img->getPixelSafe(xi, yi);
-
-			// Establecemos el color del pxel (xf,yf) con el color que hemos obtenido anteriormente.
-			setPixel(xf, yf, c); 
-		}
-	}
+	const double center_x = width / 2, center_y = height / 2;
+	const AffineTransform transform = AffineTransform::translation(center_x, center_y) * AffineTransform::rotation(beta) * AffineTransform::translation(-center_x, -center_y);
+	warpAffine(img->getView(), getView(), transform, WARP_NEAREST);
+	markModified();
 }
 
+// Zooms img around the mouse: the framebuffer pixel (x,y) shows the pixel (x,y) * zoom + mouse - zoom * size / 2 of img
+// Magnified pixels stay sharp, zooming out reads the mipmaps of img so the cost depends on the framebuffer size only
 void Image::zoom(Image* img, double zoom, float mouse_x, float mouse_y) {
-	float zoom_x_size = zoom * width;
-	float zoom_y_size = zoom * height;
-	for (int x = 0; x < width; x++) {
-		for (int y = 0; y < height; y++) {
-
-			// Get zoomed pixel color
-			Color c = img->getPixelSafe(x * zoom + mouse_x - zoom_x_size / 2, y * zoom + mouse_y - zoom_y_size / 2);
-
-			// Assign pixel color
-			setPixelSafe(x, y, c);
-		}
-	}
+	const AffineTransform framebuffer_to_img(zoom, 0, mouse_x - zoom * width / 2, 0, zoom, mouse_y - zoom * height / 2);
+	if (zoom > 1)
+		warpAffineMipmapped(*img, getView(), framebuffer_to_img.inverse());
+	else
+		warpAffine(img->getView(), getView(), framebuffer_to_img.inverse(), WARP_NEAREST);
+	markModified();
 }
 
 			///////////////////          \\\\\\\\\\\\\\\\\\\\
@@ -773,11 +1421,7 @@ void Image::zoom(Image* img, double zoom, float mouse_x, float mouse_y) {
 			///////////////////			 \\\\\\\\\\\\\\\\\\\\
 
 void Image::loadToolbar(Image* toolbar, int toolbar_size) {
-	for (unsigned int x = 0; x < width; x++) {
-		for (unsigned int y = 0; y < toolbar_size; y++) {
-			setPixel(x, height - toolbar_size + y, toolbar->getPixel(x, y));
-		}
-	}
+	blit(toolbar->getView(0, 0, width, toolbar_size), 0, height - toolbar_size);
 }
 
 void Image::chosenColor(Image* toolbar, int toolbar_size, int h, Color color) {
@@ -829,10 +1473,34 @@ void Image::drawCanvas(float x, float y, Vector2 v, int canvas_height, Color col
 
 //you can apply and algorithm for two images and store the result in the first one
 //forEachPixel( img, img2, [](Color a, Color b) { return a + b; } );
-template <typename F>
-void forEachPixel(Image& img, const Image& img2, F f) {
-	for(unsigned int pos = 0; pos < img.width * img.height; ++pos)
-		img.pixels[pos] = f( img.pixels[pos], img2.pixels[pos] );
+template <typename PixelT, typename F>
+void forEachPixel(ImageT<PixelT>& img, const ImageT<PixelT>& img2, F f) {
+	img.markModified();
+	parallelForRows(img.height, [&](unsigned int y_begin, unsigned int y_end) {
+		for(unsigned int y = y_begin; y < y_end; ++y) {
+			PixelT* row = img.getRow(y);
+			const PixelT* row2 = img2.getRow(y);
+			for(unsigned int x = 0; x < img.width; ++x)
+				row[x] = f( row[x], row2[x] );
+		}
+	});
 }
 
-#endif
\ No newline at end of file
+#endif
+
+// Pixel types images can be instantiated with
+template class FilterPipelineT<ColorGray8>;
+template class FilterPipelineT<Color>;
+template class FilterPipelineT<ColorRGBA>;
+template class FilterPipelineT<ColorRGB16>;
+template class FilterPipelineT<ColorRGBF32>;
+template class ImageViewT<ColorGray8>;
+template class ImageViewT<Color>;
+template class ImageViewT<ColorRGBA>;
+template class ImageViewT<ColorRGB16>;
+template class ImageViewT<ColorRGBF32>;
+template class ImageT<ColorGray8>;
+template class ImageT<Color>;
+template class ImageT<ColorRGBA>;
+template class ImageT<ColorRGB16>;
+template class ImageT<ColorRGBF32>;
@@ -1,5 +1,6 @@
 /*** image.h  Javi Agenjo (javi.agenjo@gmail.com) 2013
 	This file defines the class Image that allows to manipulate images.
+	Storage, views and filters are templates over the pixel type (ImageT, ImageViewT), Image is the Color one.
 	It defines all the need operators for Color and Image.
 	It has a TGA loader and saver.
 ***/
@@ -14,14 +15,180 @@
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <memory>
+#include <atomic>
 #include "framework.h"
+#include "pixelformat.h"
+#include "threadpool.h"
+#include "dirtyregion.h"
 
 //remove unsafe warnings
 #define _CRT_SECURE_NO_WARNINGS
 #pragma warning(disable:4996)
 
-//Class Image: to store a matrix of pixels
-class Image
+//Class ImageViewT: non-owning window into the pixels of an image of any pixel type (see pixelformat.h)
+//It never allocates or copies, so it is only valid while the image it points to is alive and not resized
+template <typename PixelT>
+class ImageViewT
+{
+public:
+	typedef PixelT Pixel;
+
+	PixelT* pixels; //first pixel of the window
+	unsigned int width;
+	unsigned int height;
+	unsigned int stride; //pixels between the start of two consecutive rows
+
+	ImageViewT() { pixels = NULL; width = height = stride = 0; }
+	ImageViewT(PixelT* pixels, unsigned int width, unsigned int height, unsigned int stride) {
+		this->pixels = pixels; this->width = width; this->height = height; this->stride = stride;
+	}
+
+	// Pixel access, (0,0) is the origin of the window
+	PixelT* getRow(unsigned int y) const { return pixels + y * stride; }
+	PixelT getPixel(unsigned int x, unsigned int y) const { return pixels[ y * stride + x ]; }
+	PixelT& getPixelRef(unsigned int x, unsigned int y) const { return pixels[ y * stride + x ]; }
+	void setPixel(unsigned int x, unsigned int y, const PixelT& c) const { pixels[ y * stride + x ] = c; }
+
+	bool isEmpty() const { return width == 0 || height == 0; }
+	bool isContiguous() const { return stride == width; } //rows are back to back in memory
+
+	// Returns the window from (start_x,start_y) of size width,height, clipped to this one
+	ImageViewT getSubView(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height) const;
+
+	// Copies src into this view with its origin at (x,y), clipped, one row at a time
+	// src can overlap this view (another part of the same image), then the rows are copied serially in a safe order
+	void blit(const ImageViewT& src, int x, int y);
+
+	// Fill the view with the color C
+	void fill(const PixelT& c);
+
+	// Fills clipped once, the coordinates can fall outside the view (only the part inside is written)
+	void fillSpan(int x0, int x1, int y, const PixelT& c) const; //pixels [x0,x1] of row y
+	void hline(int x, int y, int length, const PixelT& c) const { fillSpan(x, x + length - 1, y, c); }
+	void vline(int x, int y, int length, const PixelT& c) const;
+	void fillRect(int x, int y, int w, int h, const PixelT& c) const;
+
+	// Outlines and shapes with integer coordinates, clipped too
+	void drawLine(int x0, int y0, int x1, int y1, const PixelT& c, bool last = true) const; //Bresenham, (x1,y1) only if last
+	void drawEllipse(int cx, int cy, int rx, int ry, const PixelT& c, bool fill) const; //rx, ry: radius along each axis
+
+	// Saves the view to a TGA file, 32 bits if the pixels have alpha, 24 otherwise (flip_y stores the rows top-down)
+	bool saveTGA(const char* filename, bool flip_y = false) const;
+
+	// Image filters restricted to the window (alpha is never modified)
+	void grayscale();
+	void invert();
+	void channelManipulation();
+	void threshold();
+	void blur();
+	void fade();
+
+	// Filters over the window of the given radius around every pixel, clipped to the view (see integral.h)
+	void boxFilter(unsigned int radius); //mean of the window, the cost does not depend on the radius
+	void adaptiveThreshold(unsigned int radius, float offset = 0); //white where brighter than the window mean minus offset
+};
+
+typedef ImageViewT<Color> ImageView;
+typedef ImageViewT<ColorGray8> ImageViewGray8;
+typedef ImageViewT<ColorRGBA> ImageViewRGBA;
+typedef ImageViewT<ColorRGB16> ImageViewRGB16;
+typedef ImageViewT<ColorRGBF32> ImageViewRGBF32;
+
+// Converts every pixel of src into the pixel type of dst, both views must have the same size
+template <typename SrcT, typename DstT>
+void convertImage(const ImageViewT<SrcT>& src, const ImageViewT<DstT>& dst)
+{
+	const unsigned int width = std::min(src.width, dst.width);
+	parallelForRows(std::min(src.height, dst.height), [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y)
+		{
+			const SrcT* src_row = src.getRow(y);
+			DstT* dst_row = dst.getRow(y);
+			for (unsigned int x = 0; x < width; ++x)
+				convertPixel(src_row[x], dst_row[x]);
+		}
+	});
+}
+
+//Point filters a pipeline can record
+enum FilterOperation
+{
+	FILTER_NONE = 0,
+	FILTER_GRAYSCALE,
+	FILTER_THRESHOLD,
+	FILTER_INVERT,
+	FILTER_CHANNEL_MANIPULATION,
+	FILTER_CUSTOM
+};
+
+//Class FilterPipelineT: records point filters and applies all of them in a single pass
+//Nothing is computed until apply(), which walks the view once by small tiles and runs every filter on a tile
+//while it is in the cache, instead of sweeping the whole image once per filter:
+//  FilterPipeline().grayscale().threshold().invert().apply(img.getView());
+//Steps that do not change the result (a second threshold, two inverts in a row...) are dropped when recorded
+template <typename PixelT>
+class FilterPipelineT
+{
+public:
+	typedef void (*SpanFunction)(PixelT* pixels, unsigned int count); //in place over count consecutive pixels
+
+	// Bytes of every tile, well inside the L1 data cache
+	static const unsigned int TILE_BYTES = 16 * 1024;
+
+	// Record a point filter, they are applied in the same order
+	FilterPipelineT& grayscale();
+	FilterPipelineT& threshold();
+	FilterPipelineT& invert();
+	FilterPipelineT& channelManipulation();
+	FilterPipelineT& add(SpanFunction function); //any other function of the pixel value only
+
+	unsigned int size() const { return (unsigned int)operations.size(); }
+	bool isEmpty() const { return operations.empty(); }
+	void clear() { operations.clear(); }
+
+	// Runs the recorded filters over the view (rows in parallel)
+	void apply(const ImageViewT<PixelT>& view) const;
+
+private:
+	struct Operation
+	{
+		FilterOperation type;
+		SpanFunction function;
+	};
+	std::vector<Operation> operations;
+
+	FilterOperation getLastOperation() const { return operations.empty() ? FILTER_NONE : operations.back().type; }
+	FilterPipelineT& push(FilterOperation type, SpanFunction function);
+	void applySpan(PixelT* pixels, unsigned int count) const;
+};
+
+typedef FilterPipelineT<Color> FilterPipeline;
+
+//Kernels to change the size of an image (see resample.h)
+enum ResampleFilter
+{
+	RESAMPLE_NEAREST = 0, //pixel under the sample point, no filtering
+	RESAMPLE_BOX, //average of the pixels covered
+	RESAMPLE_BILINEAR, //triangle
+	RESAMPLE_BICUBIC, //Catmull-Rom
+	RESAMPLE_LANCZOS3 //windowed sinc over 3 lobes, the sharpest
+};
+
+//Frees pixel buffers allocated by the images (they are aligned, so plain delete[] cannot be used)
+struct PixelDeleter
+{
+	void operator()(void* pixels) const;
+};
+
+template <typename PixelT> class MipmapT;
+template <typename PixelT> class DrawListT;
+
+//Class ImageT: to store a matrix of pixels of type PixelT (any of the formats in pixelformat.h)
+//The buffer starts on a 64 byte boundary and every row can be padded so it starts on an aligned address too
+//The supported pixel types are instantiated in image.cpp
+template <typename PixelT>
+class ImageT
 {
 	//a general struct to store all the information about a TGA file
 	typedef struct sTGAInfo 
@@ -33,56 +200,189 @@ class Image
 	} TGAInfo;
 
 public:
+	typedef PixelT Pixel;
+
 	unsigned int width;
 	unsigned int height;
-	Color* pixels;
+	unsigned int stride; //pixels between the start of two consecutive rows (width plus padding)
+	unsigned int row_alignment; //bytes every row start is aligned to (1 means tightly packed rows)
+	std::unique_ptr<PixelT[], PixelDeleter> pixels; //owned by the image, released automatically
+
+	// Alignment of the buffer itself, a cache line
+	static const unsigned int BUFFER_ALIGNMENT = 64;
 
 	// CONSTRUCTORS 
-	Image();
-	Image(unsigned int width, unsigned int height);
-	Image(const Image& c);
-	Image& operator = (const Image& c); //assign operator
+	ImageT();
+	ImageT(unsigned int width, unsigned int height, unsigned int row_alignment = 1);
+	ImageT(const ImageT& c); //deep copy
+	ImageT(ImageT&& c); //steals the buffer of c, which is left empty
+	ImageT& operator = (const ImageT& c); //assign operator
+	ImageT& operator = (ImageT&& c); //move assign operator
+
+	// Exchange the buffers of two images without copying pixels
+	void swap(ImageT& other);
 
-	// Destructor
-	~Image();
+	// Row pitch in bytes
+	unsigned int getPitch() const { return stride * sizeof(PixelT); }
+
+	// Changes the alignment of the rows (in bytes), moving the pixels to the new layout
+	void setRowAlignment(unsigned int row_alignment);
+
+	// Get the first pixel of the row y
+	PixelT* getRow(unsigned int y) const { return pixels.get() + y * stride; }
 
 	// Get the pixel at position x,y
-	Color getPixel(unsigned int x, unsigned int y) const { return pixels[ y * width + x ]; }
-	Color& getPixelRef(unsigned int x, unsigned int y)	{ return pixels[ y * width + x ]; }
-	Color getPixelSafe(unsigned int x, unsigned int y) const {	
+	PixelT getPixel(unsigned int x, unsigned int y) const { return pixels[ y * stride + x ]; }
+	PixelT& getPixelRef(unsigned int x, unsigned int y)	{ markModified(); return pixels[ y * stride + x ]; }
+	PixelT getPixelSafe(unsigned int x, unsigned int y) const {	
 		x = clamp((unsigned int)x, 0, width-1); 
 		y = clamp((unsigned int)y, 0, height-1); 
-		return pixels[ y * width + x ]; 
+		return pixels[ y * stride + x ]; 
 	}
 
 	// Set the pixel at position x,y with value C
-	inline void setPixel(unsigned int x, unsigned int y, const Color& c) { pixels[ y * width + x ] = c; }
-	inline void setPixelSafe(unsigned int x, unsigned int y, const Color& c) const { x = clamp(x, 0, width-1); y = clamp(y, 0, height-1); pixels[ y * width + x ] = c; }
+	inline void setPixel(unsigned int x, unsigned int y, const PixelT& c) { markModified(); pixels[ y * stride + x ] = c; }
+	inline void setPixelSafe(unsigned int x, unsigned int y, const PixelT& c) const { markModified(); x = clamp(x, 0, width-1); y = clamp(y, 0, height-1); pixels[ y * stride + x ] = c; }
 
 	void resize(unsigned int width, unsigned int height);
-	void scale(unsigned int width, unsigned int height);
+	void scale(unsigned int width, unsigned int height, ResampleFilter filter = RESAMPLE_NEAREST); //filtered when shrinking, so no aliasing
 	
 	void flipY(); //flip the image top-down
 	void flipX(); //flip the image left-right
 
 	// Fill the image with the color C
-	void fill(const Color& c) { for(unsigned int pos = 0; pos < width*height; ++pos) pixels[pos] = c; }
+	void fill(const PixelT& c) { markModified(); getView().fill(c); }
+
+	// Clipped fills of a row, a column or a rectangle (see ImageViewT)
+	void fillSpan(int x0, int x1, int y, const PixelT& c) { markModified(x0, y, x1 - x0 + 1, 1); getView().fillSpan(x0, x1, y, c); }
+	void hline(int x, int y, int length, const PixelT& c) { markModified(x, y, length, 1); getView().hline(x, y, length, c); }
+	void vline(int x, int y, int length, const PixelT& c) { markModified(x, y, 1, length); getView().vline(x, y, length, c); }
+	void fillRect(int x, int y, int w, int h, const PixelT& c) { markModified(x, y, w, h); getView().fillRect(x, y, w, h, c); }
 
 	// Returns a new image with the area from (startx,starty) of size width,height
-	Image getArea(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height);
+	ImageT getArea(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height);
+
+	// Returns a view of the whole image or of the area from (startx,starty) of size width,height, without copying
+	ImageViewT<PixelT> getView() const { return ImageViewT<PixelT>(pixels.get(), width, height, stride); }
+	ImageViewT<PixelT> getView(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height) const { return getView().getSubView(start_x, start_y, width, height); }
+
+	// Copies a view (of this or another image) with its origin at (x,y), clipped to the image
+	void blit(const ImageViewT<PixelT>& src, int x, int y) { markModified(x, y, src.width, src.height); getView().blit(src, x, y); }
+
+	// Becomes a copy of src converted to this pixel type (keeps the row alignment)
+	template <typename SrcT>
+	void convertFrom(const ImageT<SrcT>& src)
+	{
+		ImageT result(src.width, src.height, row_alignment);
+		convertImage(src.getView(), result.getView());
+		*this = std::move(result);
+	}
 
-	// Save or load images from the hard drive
+	// Save or load images from the hard drive (24 or 32 bit uncompressed TGA, converted to PixelT)
 	bool loadTGA(const char* filename);
 	bool saveTGA(const char* filename);
 
+	// Image filters
+	void grayscale();
+	void invert();
+	void channelManipulation();
+	void threshold();
+	void blur();
+	void fade();
+	void boxFilter(unsigned int radius);
+	void adaptiveThreshold(unsigned int radius, float offset = 0);
+
+	// Applies a chain of point filters in a single pass
+	void apply(const FilterPipelineT<PixelT>& pipeline) { markModified(); pipeline.apply(getView()); }
+
+	// Draws the shapes recorded in a command buffer, by tiles in parallel (see drawlist.h)
+	void draw(const DrawListT<PixelT>& list);
+
+	// Used to easy code
+	#ifndef IGNORE_LAMBDAS
+
+	// Applies an algorithm to every pixel in an image
+	// You can use lambda sintax:   img.forEachPixel( [](Color c) { return c*2; });
+	// Or callback sintax:   img.forEachPixel( mycallback ); //the callback has to be Color mycallback(Color c) { ... }
+	// Rows are processed in parallel, so the callback must not modify shared state
+	template <typename F>
+	ImageT& forEachPixel( F callback )
+	{
+		markModified();
+		parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+			for(unsigned int y = y_begin; y < y_end; ++y)
+			{
+				PixelT* row = getRow(y);
+				for(unsigned int x = 0; x < width; ++x)
+					row[x] = callback(row[x]);
+			}
+		});
+		return *this;
+	}
+
+	#endif
+
+	// Every write through the image marks it as modified, so the mipmaps are built again when asked for
+	// Writes through a view or getRow can not be seen, call markModified() after them
+	void markModified() const { modified.store(true, std::memory_order_relaxed); all_dirty.store(true, std::memory_order_relaxed); }
+
+	// Same, only the rectangle from (x,y) of size w,h (clipped) was written: it is added to the dirty region
+	// The region is not thread safe, call it from the thread drawing on the image (markModified() can be called from any)
+	void markModified(int x, int y, int w, int h) const;
+
+	// The parts written since the last takeDirtyRects() (see dirtyregion.h), so only they have to be sent to the screen
+	bool isDirty() const { return all_dirty.load(std::memory_order_relaxed) || !dirty_region.isEmpty(); }
+	std::vector<DirtyRect> takeDirtyRects(); //the whole image when a write did not tell where, the region is left empty
+
+	// Prefiltered copies of half the size of the previous one (see mipmap.h), built once and kept until the image changes
+	const MipmapT<PixelT>& getMipmaps() const;
+	ImageViewT<PixelT> getMipmapLevel(unsigned int level) const; //0 is the image itself, clamped to the smallest level
+	bool hasMipmaps() const { return mipmaps && !modified.load(std::memory_order_relaxed); } //built and up to date
+
+private:
+	mutable std::shared_ptr<const MipmapT<PixelT>> mipmaps;
+	mutable std::atomic<bool> modified; //a plain store, so setPixel can be called from several threads
+	mutable DirtyRegion dirty_region;
+	mutable std::atomic<bool> all_dirty; //a new image, or a write of an unknown part
+};
+
+typedef ImageT<ColorGray8> ImageGray8; //masks, 1/3 of the memory of a Color image
+typedef ImageT<ColorRGBA> ImageRGBA;
+typedef ImageT<ColorRGB16> ImageRGB16;
+typedef ImageT<ColorRGBF32> ImageRGBF32; //chains of filters without quantising between them
+
+//Class Image: the 3 byte Color image used by the application, with the drawing, canvas and pattern methods
+class Image : public ImageT<Color>
+{
+public:
+	// CONSTRUCTORS 
+	Image() {}
+	Image(unsigned int width, unsigned int height, unsigned int row_alignment = 1) : ImageT<Color>(width, height, row_alignment) {}
+	Image(ImageT<Color>&& c) : ImageT<Color>(std::move(c)) {} //takes the buffer of a generic Color image
+
+	// Returns a new image with the area from (startx,starty) of size width,height
+	Image getArea(unsigned int start_x, unsigned int start_y, unsigned int width, unsigned int height) { return ImageT<Color>::getArea(start_x, start_y, width, height); }
+
 	// Methods for taking a screenshot
 	char** getCurrentTime(char* current_time);
 	void screenshot(const int width, const int height, const std::string str);
 
 	// Primitive shapes
-	void drawLine(float x0, float y0, Vector2 v, Color c);
+	void drawLine(float x0, float y0, Vector2 v, Color c); //from (x0,y0) to (x0,y0) + v
+	void drawLine(int x0, int y0, int x1, int y1, Color c); //both ends included, clipped to the image
+	void drawLines(const std::vector<Vector2>& points, Color c, bool closed = false); //polyline, the shared ends are drawn once
 	void drawRectangle(int startx, int starty, int w, int h, Color c, bool fill);
 	void drawCircle(int a, int b, int r, Color c, bool fill);
+	void drawEllipse(int cx, int cy, int rx, int ry, Color c, bool fill); //rx, ry: radius along each axis
+	void drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, Color c, bool fill); //filled: the pixels whose centre is inside (see raster.h)
+	void drawTriangle(const Vector2& p0, const Vector2& p1, const Vector2& p2, Color c0, Color c1, Color c2); //filled, the color of every vertex interpolated
+	void drawPolygon(const std::vector<Vector2>& points, Color c, bool fill); //concave and self-intersecting too (even-odd rule)
+
+	// Anti-aliased shapes, the coordinates can have fractions and the pixels on the edges are blended (see raster.h)
+	void drawLineAA(const Vector2& p0, const Vector2& p1, Color c);
+	void drawCircleAA(const Vector2& center, float r, Color c, bool fill);
+	void drawRectangleAA(float x, float y, float w, float h, Color c, bool fill); //from the corner (x,y)
+	void drawPolygonAA(const std::vector<Vector2>& points, Color c, bool fill);
 	
 	// Frame patterns
 	void drawGradient(int w, int h);
@@ -92,14 +392,8 @@ public:
 	void drawSinusoidGradient(const int width, const int height, const int window_width, const int window_height);
 	void drawChessBoard(const int width, const int height, const int window_width, const int window_heigth);
 
-	// Image filters
-	void grayscale();
-	void invert();
-	void channelManipulation();
+	// Image filters (the point filters are inherited from ImageT)
 	void tryAllSwaps();
-	void threshold();
-	void blur();
-	void fade();
 
 	//image edit
 	void rotate(Image* img, double beta);
@@ -109,24 +403,6 @@ public:
 	void loadToolbar(Image* toolbar, int toolbar_size);
 	void chosenColor(Image* toolbar, int toolbar_size, int h, Color color);
 	void drawCanvas(float x, float y, Vector2 v, int canvas_height, Color color);
-
-	// Used to easy code
-	#ifndef IGNORE_LAMBDAS
-
-	// Applies an algorithm to every pixel in an image
-	// You can use lambda sintax:   img.forEachPixel( [](Color c) { return c*2; });
-	// Or callback sintax:   img.forEachPixel( mycallback ); //the callback has to be Color mycallback(Color c) { ... }
-	template <typename F>
-	Image& forEachPixel( F callback )
-	{
-		for(unsigned int pos = 0; pos < width*height; ++pos)
-			pixels[pos] = callback(pixels[pos]);
-		return *this;
-	}
-
-	#endif
-
-
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "integral.h"
+#include <cassert>
+
+template <typename PixelT>
+void IntegralImageT<PixelT>::build(const ImageViewT<PixelT>& view, bool with_squares)
+{
+	width = view.width;
+	height = view.height;
+	const unsigned int row = (width + 1) * channels;
+	sums.assign(row * (height + 1), 0);
+	squares.assign(with_squares ? sums.size() : 0, 0);
+
+	// Running sums along every row (row y of the image goes to row y + 1 of the table)
+	parallelForRows(height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y)
+		{
+			const PixelT* in = view.getRow(y);
+			Sum* out = &sums[(y + 1) * row];
+			Sum* out_squares = with_squares ? &squares[(y + 1) * row] : NULL;
+			for (unsigned int x = 0; x < width; ++x)
+				for (unsigned int c = 0; c < channels; ++c)
+				{
+					const Sum value = (Sum)in[x].v[c];
+					out[(x + 1) * channels + c] = out[x * channels + c] + value;
+					if (out_squares)
+						out_squares[(x + 1) * channels + c] = out_squares[x * channels + c] + value * value;
+				}
+		}
+	});
+
+	// Then down the columns, every task walks a strip of them in row order
+	parallelForRows(row, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int y = 1; y <= height; ++y)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+				sums[y * row + i] += sums[(y - 1) * row + i];
+			if (with_squares)
+				for (unsigned int i = begin; i < end; ++i)
+					squares[y * row + i] += squares[(y - 1) * row + i];
+		}
+	});
+}
+
+template <typename PixelT>
+bool IntegralImageT<PixelT>::clip(int x, int y, int w, int h, unsigned int& x0, unsigned int& y0, unsigned int& x1, unsigned int& y1) const
+{
+	const int left = std::max(x, 0), top = std::max(y, 0);
+	const int right = std::min(x + w, (int)width), bottom = std::min(y + h, (int)height);
+	if (left >= right || top >= bottom)
+		return false;
+	x0 = left; y0 = top; x1 = right; y1 = bottom;
+	return true;
+}
+
+template <typename PixelT>
+unsigned int IntegralImageT<PixelT>::getCount(int x, int y, int w, int h) const
+{
+	unsigned int x0, y0, x1, y1;
+	return clip(x, y, w, h, x0, y0, x1, y1) ? (x1 - x0) * (y1 - y0) : 0;
+}
+
+template <typename PixelT>
+typename IntegralImageT<PixelT>::Sum IntegralImageT<PixelT>::getSum(int x, int y, int w, int h, unsigned int channel) const
+{
+	unsigned int x0, y0, x1, y1;
+	return clip(x, y, w, h, x0, y0, x1, y1) ? lookup(sums, x0, y0, x1, y1, channel) : 0;
+}
+
+template <typename PixelT>
+typename IntegralImageT<PixelT>::Sum IntegralImageT<PixelT>::getSumOfSquares(int x, int y, int w, int h, unsigned int channel) const
+{
+	assert(hasSquares() && "the table was built without squares");
+	unsigned int x0, y0, x1, y1;
+	return clip(x, y, w, h, x0, y0, x1, y1) ? lookup(squares, x0, y0, x1, y1, channel) : 0;
+}
+
+template <typename PixelT>
+double IntegralImageT<PixelT>::getMean(int x, int y, int w, int h, unsigned int channel) const
+{
+	unsigned int x0, y0, x1, y1;
+	if (!clip(x, y, w, h, x0, y0, x1, y1))
+		return 0;
+	return (double)lookup(sums, x0, y0, x1, y1, channel) / ((x1 - x0) * (y1 - y0));
+}
+
+template <typename PixelT>
+double IntegralImageT<PixelT>::getVariance(int x, int y, int w, int h, unsigned int channel) const
+{
+	assert(hasSquares() && "the table was built without squares");
+	unsigned int x0, y0, x1, y1;
+	if (!clip(x, y, w, h, x0, y0, x1, y1))
+		return 0;
+	const double count = (double)(x1 - x0) * (y1 - y0);
+	const double mean = lookup(sums, x0, y0, x1, y1, channel) / count;
+	const double variance = lookup(squares, x0, y0, x1, y1, channel) / count - mean * mean;
+	return variance > 0 ? variance : 0; //rounding can leave it slightly negative
+}
+
+// Pixel types the table can be built from
+template class IntegralImageT<ColorGray8>;
+template class IntegralImageT<Color>;
+template class IntegralImageT<ColorRGBA>;
+template class IntegralImageT<ColorRGB16>;
+template class IntegralImageT<ColorRGBF32>;
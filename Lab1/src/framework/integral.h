@@ -0,0 +1,57 @@
+/*  integral.h
+	Summed-area table of an image: every entry holds the sum of the pixels above and to the left of it,
+	so the sum of any rectangle takes four lookups per channel whatever its size.
+	The table can also keep the sums of the squared values, which give the variance of a rectangle.
+	It is built in parallel, first the rows and then strips of columns.
+*/
+
+#ifndef INTEGRAL_H
+#define INTEGRAL_H
+
+#include <type_traits>
+#include <limits>
+#include "image.h"
+
+template <typename PixelT>
+class IntegralImageT
+{
+public:
+	typedef PixelTraits<PixelT> Traits;
+	//exact sums for integer channels, double for float ones
+	typedef typename std::conditional<std::numeric_limits<typename Traits::Channel>::is_integer, unsigned long long, double>::type Sum;
+	static const unsigned int channels = Traits::color_channels;
+
+	unsigned int width;
+	unsigned int height;
+
+	IntegralImageT() { width = height = 0; }
+	explicit IntegralImageT(const ImageViewT<PixelT>& view, bool with_squares = true) { build(view, with_squares); }
+
+	// Computes the table of the view (with_squares also keeps the squared sums needed by getVariance)
+	void build(const ImageViewT<PixelT>& view, bool with_squares = true);
+	bool hasSquares() const { return !squares.empty(); }
+
+	// Rectangle queries, (x,y) is the top-left corner and the rectangle is clipped to the image
+	unsigned int getCount(int x, int y, int w, int h) const;
+	Sum getSum(int x, int y, int w, int h, unsigned int channel) const;
+	Sum getSumOfSquares(int x, int y, int w, int h, unsigned int channel) const;
+	double getMean(int x, int y, int w, int h, unsigned int channel) const; //0 when the rectangle is outside
+	double getVariance(int x, int y, int w, int h, unsigned int channel) const;
+
+private:
+	std::vector<Sum> sums; //(width + 1) * (height + 1) * channels, the first row and column are 0
+	std::vector<Sum> squares; //same layout, empty when not requested
+
+	// Clips the rectangle to [x0,x1) x [y0,y1), false when nothing is left
+	bool clip(int x, int y, int w, int h, unsigned int& x0, unsigned int& y0, unsigned int& x1, unsigned int& y1) const;
+
+	Sum lookup(const std::vector<Sum>& table, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int channel) const {
+		const unsigned int row = (width + 1) * channels;
+		return table[y1 * row + x1 * channels + channel] - table[y0 * row + x1 * channels + channel]
+			- table[y1 * row + x0 * channels + channel] + table[y0 * row + x0 * channels + channel];
+	}
+};
+
+typedef IntegralImageT<Color> IntegralImage;
+
+#endif
@@ -0,0 +1,200 @@
+#include "lut.h"
+#include "simd.h"
+
+// Runs fn(row, count) over bands of rows of a view (a single span per band when the rows are contiguous)
+template <typename PixelT, typename F>
+static void forEachSpan(const ImageViewT<PixelT>& view, F fn)
+{
+	parallelForRows(view.height, [&](unsigned int y_begin, unsigned int y_end) {
+		if (view.isContiguous())
+			fn(view.getRow(y_begin), (y_end - y_begin) * view.width);
+		else
+			for (unsigned int y = y_begin; y < y_end; ++y)
+				fn(view.getRow(y), view.width);
+	});
+}
+
+// Channel tables
+
+ChannelLUT::ChannelLUT()
+{
+	for (int c = 0; c < 3; ++c) {
+		source[c] = c;
+		for (int v = 0; v < 256; ++v)
+			table[c][v] = v;
+	}
+}
+
+ChannelLUT ChannelLUT::invert()
+{
+	return fromCurve([](int v) { return 255 - v; });
+}
+
+ChannelLUT ChannelLUT::channelManipulation()
+{
+	ChannelLUT lut;
+	for (int v = 0; v < 256; ++v) {
+		lut.table[0][v] = std::min(v * 2, 255);
+		lut.table[1][v] = v / 2;
+		lut.table[2][v] = v / 2;
+	}
+	return lut;
+}
+
+ChannelLUT ChannelLUT::permutation(int r_source, int g_source, int b_source)
+{
+	ChannelLUT lut;
+	const int sources[3] = { r_source, g_source, b_source };
+	for (int c = 0; c < 3; ++c) {
+		if (sources[c] < 0)
+			memset(lut.table[c], 0, 256); //black, the source does not matter
+		else
+			lut.source[c] = sources[c];
+	}
+	return lut;
+}
+
+ChannelLUT ChannelLUT::then(const ChannelLUT& next) const
+{
+	// out[c] = next.table[c][ table[k][ in[source[k]] ] ] with k = next.source[c]
+	ChannelLUT result;
+	for (int c = 0; c < 3; ++c) {
+		const int k = next.source[c];
+		result.source[c] = source[k];
+		for (int v = 0; v < 256; ++v)
+			result.table[c][v] = next.table[c][ table[k][v] ];
+	}
+	return result;
+}
+
+void ChannelLUT::apply(Color* pixels, unsigned int count) const
+{
+	for (unsigned int i = 0; i < count; ++i)
+		pixels[i] = (*this)(pixels[i]);
+}
+
+ChannelLUT::WideTables ChannelLUT::getWideTables() const
+{
+	WideTables wide;
+	for (int c = 0; c < 3; ++c) {
+		wide.source[c] = source[c];
+		for (int v = 0; v < 256; ++v)
+			wide.entries[c][v] = (unsigned int)table[c][v] << (8 * c);
+	}
+	return wide;
+}
+
+void ChannelLUT::apply(ColorRGBA* pixels, unsigned int count) const
+{
+	apply(pixels, count, getWideTables());
+}
+
+void ChannelLUT::apply(ColorRGBA* pixels, unsigned int count, const WideTables& tables)
+{
+	getPixelKernels().lookupRGBA(pixels, count, tables.entries, tables.source);
+}
+
+void ChannelLUT::apply(const ImageView& view) const
+{
+	forEachSpan(view, [&](Color* pixels, unsigned int count) { apply(pixels, count); });
+}
+
+void ChannelLUT::apply(const ImageViewRGBA& view) const
+{
+	//the wide tables are built once for the whole view
+	const WideTables wide = getWideTables();
+	forEachSpan(view, [&](ColorRGBA* pixels, unsigned int count) { apply(pixels, count, wide); });
+}
+
+// 3D tables
+
+CubeLUT::CubeLUT(unsigned int size)
+{
+	this->size = clamp(size, 2, 256);
+
+	//identity nodes
+	nodes.resize(this->size * this->size * this->size);
+	for (unsigned int b = 0; b < this->size; ++b)
+		for (unsigned int g = 0; g < this->size; ++g)
+			for (unsigned int r = 0; r < this->size; ++r)
+			{
+				Color& node = getNode(r, g, b);
+				node.r = getNodeValue(r);
+				node.g = getNodeValue(g);
+				node.b = getNodeValue(b);
+			}
+
+	//position of every input value in the lattice, in 1/256 steps
+	for (unsigned int v = 0; v < 256; ++v) {
+		const unsigned int position = v * (this->size - 1); //in 1/255 of a node
+		unsigned int i = position / 255;
+		unsigned int w = ((position % 255) * 256 + 127) / 255;
+		if (i == this->size - 1) { i = this->size - 2; w = 256; } //the last value uses the last cell
+		index[v] = (unsigned char)i;
+		weight[v] = (unsigned short)w;
+	}
+}
+
+CubeLUT CubeLUT::fromChannelLUT(const ChannelLUT& lut, unsigned int size)
+{
+	return fromFunction(lut, size);
+}
+
+CubeLUT CubeLUT::then(const ChannelLUT& next) const
+{
+	CubeLUT result(*this);
+	for (unsigned int i = 0; i < nodes.size(); ++i)
+		result.nodes[i] = next(nodes[i]);
+	return result;
+}
+
+CubeLUT CubeLUT::then(const CubeLUT& next) const
+{
+	CubeLUT result(*this);
+	for (unsigned int i = 0; i < nodes.size(); ++i)
+		result.nodes[i] = next(nodes[i]);
+	return result;
+}
+
+Color CubeLUT::operator () (const Color& c) const
+{
+	const unsigned int wr = weight[c.r], wg = weight[c.g], wb = weight[c.b];
+	const Color* n = &nodes[ (index[c.b] * size + index[c.g]) * size + index[c.r] ];
+	const unsigned int dy = size;
+	const unsigned int dz = size * size;
+
+	//fixed point: red and green keep 8 fraction bits, blue rounds them away
+	Color out;
+	for (int k = 0; k < 3; ++k) {
+		const unsigned int c00 = n[0].v[k] * (256 - wr) + n[1].v[k] * wr;
+		const unsigned int c10 = n[dy].v[k] * (256 - wr) + n[dy + 1].v[k] * wr;
+		const unsigned int c01 = n[dz].v[k] * (256 - wr) + n[dz + 1].v[k] * wr;
+		const unsigned int c11 = n[dz + dy].v[k] * (256 - wr) + n[dz + dy + 1].v[k] * wr;
+		const unsigned int c0 = (c00 * (256 - wg) + c10 * wg + 128) >> 8;
+		const unsigned int c1 = (c01 * (256 - wg) + c11 * wg + 128) >> 8;
+		out.v[k] = (unsigned char)((c0 * (256 - wb) + c1 * wb + 32768) >> 16);
+	}
+	return out;
+}
+
+void CubeLUT::apply(Color* pixels, unsigned int count) const
+{
+	for (unsigned int i = 0; i < count; ++i)
+		pixels[i] = (*this)(pixels[i]);
+}
+
+void CubeLUT::apply(ColorRGBA* pixels, unsigned int count) const
+{
+	for (unsigned int i = 0; i < count; ++i)
+		pixels[i] = ColorRGBA((*this)(pixels[i].toColor()), pixels[i].a);
+}
+
+void CubeLUT::apply(const ImageView& view) const
+{
+	forEachSpan(view, [&](Color* pixels, unsigned int count) { apply(pixels, count); });
+}
+
+void CubeLUT::apply(const ImageViewRGBA& view) const
+{
+	forEachSpan(view, [&](ColorRGBA* pixels, unsigned int count) { apply(pixels, count); });
+}
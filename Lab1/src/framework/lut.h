@@ -0,0 +1,117 @@
+/*  lut.h
+	Lookup tables for colour transforms of 8 bit images (Color and ColorRGBA, alpha is kept).
+	ChannelLUT: a 256 entry table per output channel, indexed by one input channel. It covers per channel
+	curves (invert, channelManipulation, gamma...) and channel swaps, and a chain of them composes exactly
+	into a single table.
+	CubeLUT: a 3D RGB lattice with trilinear interpolation for transforms that mix channels (grading,
+	grayscale, threshold...). It is exact at the nodes and interpolated between them.
+	Applying a table costs the same whatever the number of transforms folded into it.
+*/
+
+#ifndef LUT_H
+#define LUT_H
+
+#include "image.h"
+
+class ChannelLUT
+{
+public:
+	unsigned char table[3][256]; //output value of every channel for every input value
+	unsigned char source[3]; //input channel read by every output channel (0 red, 1 green, 2 blue)
+
+	ChannelLUT(); //identity
+
+	// Common tables
+	static ChannelLUT invert();
+	static ChannelLUT channelManipulation(); //red * 2, green / 2, blue / 2
+	static ChannelLUT permutation(int r_source, int g_source, int b_source); //channel to copy in every channel, -1 is black
+
+	// Same curve for the three channels, curve(value) is clamped to 0..255
+	template <typename F>
+	static ChannelLUT fromCurve(F curve)
+	{
+		ChannelLUT lut;
+		for (int v = 0; v < 256; ++v)
+			lut.table[0][v] = lut.table[1][v] = lut.table[2][v] = (unsigned char)clamp((float)curve(v), 0.0f, 255.0f);
+		return lut;
+	}
+
+	// Table that applies this one and then next
+	ChannelLUT then(const ChannelLUT& next) const;
+
+	Color operator () (const Color& c) const {
+		Color out;
+		out.r = table[0][c.v[source[0]]];
+		out.g = table[1][c.v[source[1]]];
+		out.b = table[2][c.v[source[2]]];
+		return out;
+	}
+
+	// Transform count consecutive pixels in place
+	void apply(Color* pixels, unsigned int count) const;
+	void apply(ColorRGBA* pixels, unsigned int count) const; //builds the wide tables at every call
+
+	// Transform a view in place (rows in parallel)
+	void apply(const ImageView& view) const;
+	void apply(const ImageViewRGBA& view) const;
+
+	// Tables with 32 bit entries already moved to the byte of their channel, for the gathers of simd.h
+	// Build them once to apply the same table to many spans of ColorRGBA
+	struct WideTables
+	{
+		unsigned int entries[3][256];
+		unsigned char source[3];
+	};
+	WideTables getWideTables() const;
+	static void apply(ColorRGBA* pixels, unsigned int count, const WideTables& tables);
+};
+
+class CubeLUT
+{
+public:
+	unsigned int size; //nodes per axis
+	std::vector<Color> nodes; //size * size * size, red varies fastest
+
+	// Identity, the default 16 nodes fall exactly every 17 values
+	CubeLUT(unsigned int size = 16);
+
+	// Samples transform(Color) -> Color at the nodes
+	template <typename F>
+	static CubeLUT fromFunction(F transform, unsigned int size = 16)
+	{
+		CubeLUT lut(size);
+		for (unsigned int i = 0; i < lut.nodes.size(); ++i)
+			lut.nodes[i] = transform(lut.nodes[i]);
+		return lut;
+	}
+
+	static CubeLUT fromChannelLUT(const ChannelLUT& lut, unsigned int size = 16);
+
+	// Input value of the node i of an axis
+	unsigned char getNodeValue(unsigned int i) const { return (unsigned char)((i * 255 + (size - 1) / 2) / (size - 1)); }
+
+	Color& getNode(unsigned int r, unsigned int g, unsigned int b) { return nodes[ (b * size + g) * size + r ]; }
+	const Color& getNode(unsigned int r, unsigned int g, unsigned int b) const { return nodes[ (b * size + g) * size + r ]; }
+
+	// Table that applies this one and then next (next is evaluated at the nodes of this one)
+	CubeLUT then(const ChannelLUT& next) const;
+	CubeLUT then(const CubeLUT& next) const;
+
+	// Trilinear interpolation of the 8 nodes around c
+	Color operator () (const Color& c) const;
+
+	// Transform count consecutive pixels in place
+	void apply(Color* pixels, unsigned int count) const;
+	void apply(ColorRGBA* pixels, unsigned int count) const;
+
+	// Transform a view in place (rows in parallel)
+	void apply(const ImageView& view) const;
+	void apply(const ImageViewRGBA& view) const;
+
+private:
+	//lower node of every input value and the weight (0..256) of the upper one
+	unsigned char index[256];
+	unsigned short weight[256];
+};
+
+#endif
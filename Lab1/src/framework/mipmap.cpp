@@ -0,0 +1,130 @@
+#include "mipmap.h"
+#include "resample.h"
+#include <limits>
+
+// Average of every 2x2 block of src, for the levels exactly half the size of the previous one
+template <typename PixelT>
+static void halve(const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst)
+{
+	typedef PixelTraits<PixelT> Traits;
+	typedef typename Traits::Accumulator Accumulator;
+	const unsigned int channels = Traits::color_channels + (Traits::has_alpha ? 1 : 0);
+	const Accumulator rounding = std::numeric_limits<typename Traits::Channel>::is_integer ? 2 : 0;
+	parallelForRows(dst.height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y) {
+			const PixelT* top = src.getRow(2 * y);
+			const PixelT* bottom = src.getRow(2 * y + 1);
+			PixelT* out = dst.getRow(y);
+			for (unsigned int x = 0; x < dst.width; ++x)
+				for (unsigned int c = 0; c < channels; ++c)
+					out[x].v[c] = (typename Traits::Channel)(((Accumulator)top[2 * x].v[c] + top[2 * x + 1].v[c] + bottom[2 * x].v[c] + bottom[2 * x + 1].v[c] + rounding) / 4);
+		}
+	});
+}
+
+template <typename PixelT>
+MipmapT<PixelT>::MipmapT(const ImageViewT<PixelT>& source)
+{
+	//all the levels are allocated first, the views of the previous ones must stay valid
+	unsigned int width = source.width, height = source.height;
+	while (width > 1 || height > 1) {
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		levels.push_back(ImageT<PixelT>(width, height));
+	}
+
+	//every level is made from the previous one, which is already filtered
+	ImageViewT<PixelT> previous = source;
+	for (unsigned int i = 0; i < levels.size(); ++i) {
+		const ImageViewT<PixelT> level = levels[i].getView();
+		if (level.width * 2 == previous.width && level.height * 2 == previous.height)
+			halve(previous, level);
+		else
+			resample(previous, level, RESAMPLE_BOX); //odd sizes, the box covers fractions of pixels
+		previous = level;
+	}
+}
+
+template <typename PixelT>
+void resampleMipmapped(const ImageT<PixelT>& image, const ImageViewT<PixelT>& dst, ResampleFilter filter)
+{
+	if (image.width == 0 || image.height == 0 || dst.isEmpty())
+		return;
+
+	//the level n is at least (size / 2^n) pixels wide, so it is not smaller than dst while 2^n <= size / dst
+	const float minification = std::min((float)image.width / dst.width, (float)image.height / dst.height);
+	const unsigned int level = (unsigned int)floor(MipmapT<PixelT>::getLevelOfDetail(minification));
+	resample(image.getMipmapLevel(level), dst, filter);
+}
+
+template <typename PixelT>
+void warpAffineMipmapped(const ImageT<PixelT>& image, const ImageViewT<PixelT>& dst, const AffineTransform& transform,
+	WarpEdge edge, const PixelT& border)
+{
+	typedef PixelTraits<PixelT> Traits;
+	if (image.width == 0 || image.height == 0 || dst.isEmpty() || transform.determinant() == 0)
+		return;
+
+	//source pixels crossed by a step of one output pixel, along the longest axis
+	const AffineTransform inverse = transform.inverse();
+	const double step_x = sqrt(inverse.m[0] * inverse.m[0] + inverse.m[3] * inverse.m[3]);
+	const double step_y = sqrt(inverse.m[1] * inverse.m[1] + inverse.m[4] * inverse.m[4]);
+	const float lod = MipmapT<PixelT>::getLevelOfDetail((float)std::max(step_x, step_y));
+	if (lod == 0) {
+		warpAffine(image.getView(), dst, transform, WARP_BILINEAR, edge, border);
+		return;
+	}
+
+	const unsigned int last = image.getMipmaps().getLevelCount() - 1;
+	const unsigned int level = std::min((unsigned int)lod, last);
+	const float fraction = level < last ? lod - level : 0.0f;
+
+	//the transform of a level maps its pixels to the image ones first
+	auto warpLevel = [&](unsigned int level, const ImageViewT<PixelT>& target) {
+		const ImageViewT<PixelT> source = image.getMipmapLevel(level);
+		const AffineTransform to_image = AffineTransform::scaling((double)image.width / source.width, (double)image.height / source.height);
+		warpAffine(source, target, transform * to_image, WARP_BILINEAR, edge, border);
+	};
+
+	//the second level starts as a copy of dst, so the pixels the edge mode keeps blend into themselves
+	ImageT<PixelT> coarse;
+	if (fraction > 1.0f / 256) {
+		coarse = ImageT<PixelT>(dst.width, dst.height);
+		coarse.blit(dst, 0, 0);
+		warpLevel(level + 1, coarse.getView());
+	}
+	warpLevel(level, dst);
+	if (fraction <= 1.0f / 256)
+		return;
+
+	const unsigned int channels = Traits::color_channels + (Traits::has_alpha ? 1 : 0);
+	const float rounding = std::numeric_limits<typename Traits::Channel>::is_integer ? 0.5f : 0.0f;
+	parallelForRows(dst.height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y) {
+			PixelT* out = dst.getRow(y);
+			const PixelT* in = coarse.getRow(y);
+			for (unsigned int x = 0; x < dst.width; ++x)
+				for (unsigned int c = 0; c < channels; ++c)
+					out[x].v[c] = Traits::fromFloat(out[x].v[c] + (in[x].v[c] - (float)out[x].v[c]) * fraction + rounding);
+		}
+	});
+}
+
+// Pixel types the pyramid can be built for
+template class MipmapT<ColorGray8>;
+template class MipmapT<Color>;
+template class MipmapT<ColorRGBA>;
+template class MipmapT<ColorRGB16>;
+template class MipmapT<ColorRGBF32>;
+
+template void resampleMipmapped(const ImageT<ColorGray8>&, const ImageViewT<ColorGray8>&, ResampleFilter);
+template void resampleMipmapped(const ImageT<Color>&, const ImageViewT<Color>&, ResampleFilter);
+template void resampleMipmapped(const ImageT<ColorRGBA>&, const ImageViewT<ColorRGBA>&, ResampleFilter);
+template void resampleMipmapped(const ImageT<ColorRGB16>&, const ImageViewT<ColorRGB16>&, ResampleFilter);
+template void resampleMipmapped(const ImageT<ColorRGBF32>&, const ImageViewT<ColorRGBF32>&, ResampleFilter);
+
+template void warpAffineMipmapped(const ImageT<ColorGray8>&, const ImageViewT<ColorGray8>&, const AffineTransform&, WarpEdge, const ColorGray8&);
+template void warpAffineMipmapped(const ImageT<Color>&, const ImageViewT<Color>&, const AffineTransform&, WarpEdge, const Color&);
+template void warpAffineMipmapped(const ImageT<ColorRGBA>&, const ImageViewT<ColorRGBA>&, const AffineTransform&, WarpEdge, const ColorRGBA&);
+template void warpAffineMipmapped(const ImageT<ColorRGB16>&, const ImageViewT<ColorRGB16>&, const AffineTransform&, WarpEdge, const ColorRGB16&);
+template void warpAffineMipmapped(const ImageT<ColorRGBF32>&, const ImageViewT<ColorRGBF32>&, const AffineTransform&, WarpEdge, const ColorRGBF32&);
@@ -0,0 +1,39 @@
+/*  mipmap.h
+	Image pyramid: copies of an image, each one half the size of the previous one down to 1x1, box filtered
+	so every pixel is the average of the ones it covers. Shrinking the image by n then only has to read the
+	level closest to the new size, which has a few pixels per output one instead of n * n.
+	An ImageT keeps its pyramid (see ImageT::getMipmaps) until it is modified.
+*/
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "image.h"
+#include "warp.h"
+
+template <typename PixelT>
+class MipmapT
+{
+public:
+	std::vector< ImageT<PixelT> > levels; //levels[i] is level i + 1, level 0 is the image itself
+
+	explicit MipmapT(const ImageViewT<PixelT>& source);
+
+	unsigned int getLevelCount() const { return (unsigned int)levels.size() + 1; } //the image included
+	ImageViewT<PixelT> getLevel(unsigned int level) const { return levels[level - 1].getView(); } //from 1
+
+	// Level whose pixels match the size of the output ones, for a minification (source pixels per output pixel)
+	// It has a fraction when the size falls between two levels, 0 when magnifying
+	static float getLevelOfDetail(float minification) { return minification > 1 ? log2f(minification) : 0; }
+};
+
+// Resizes image into dst starting from the smallest level still at least as big as dst
+template <typename PixelT>
+void resampleMipmapped(const ImageT<PixelT>& image, const ImageViewT<PixelT>& dst, ResampleFilter filter);
+
+// Trilinear warp: bilinear in the two levels around the level of detail of transform, blended by its fraction
+template <typename PixelT>
+void warpAffineMipmapped(const ImageT<PixelT>& image, const ImageViewT<PixelT>& dst, const AffineTransform& transform,
+	WarpEdge edge = WARP_EDGE_CLAMP, const PixelT& border = PixelT());
+
+#endif
@@ -0,0 +1,165 @@
+/*  pixelformat.h
+	Pixel types an ImageT (see image.h) can store and the conversions between them:
+	gray8 (ColorGray8), RGB8 (Color), RGBA8 (ColorRGBA), RGB16 (ColorRGB16) and RGBF32 (ColorRGBF32).
+	PixelTraits tells the generic image code how many color channels a pixel has, their type
+	and whether an alpha channel follows them. convertPixel converts a single pixel.
+	Float channels go from 0 to 1 but are not clamped above 1, so they can hold HDR values.
+*/
+
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+
+#include "framework.h"
+
+//single 8 bit channel, for gray images and masks
+class ColorGray8
+{
+public:
+	union
+	{
+		unsigned char value;
+		unsigned char v[1];
+	};
+	ColorGray8() { value = 0; }
+	explicit ColorGray8(float value) { this->value = (unsigned char)value; }
+};
+
+//16 bits per channel
+class ColorRGB16
+{
+public:
+	union
+	{
+		struct { unsigned short r;
+				 unsigned short g;
+				 unsigned short b; };
+		unsigned short v[3];
+	};
+	ColorRGB16() { r = g = b = 0; }
+	ColorRGB16(float r, float g, float b) { this->r = (unsigned short)r; this->g = (unsigned short)g; this->b = (unsigned short)b; }
+};
+
+//32 bit float per channel
+class ColorRGBF32
+{
+public:
+	union
+	{
+		struct { float r, g, b; };
+		float v[3];
+	};
+	ColorRGBF32() { r = g = b = 0.0f; }
+	ColorRGBF32(float r, float g, float b) { this->r = r; this->g = g; this->b = b; }
+};
+
+//names matching the rest of the formats
+typedef Color ColorRGB8;
+typedef ColorRGBA ColorRGBA8;
+
+template <typename PixelT> struct PixelTraits;
+
+//3 bytes per pixel, no alpha
+template <> struct PixelTraits<Color>
+{
+	typedef unsigned char Channel;
+	typedef int Accumulator; //wide enough to add several channels without overflow
+	static const unsigned int color_channels = 3;
+	static const bool has_alpha = false; //when true the alpha is the channel after the color ones
+	static Channel maxValue() { return 255; }
+	static Channel fromFloat(float x) { return (Channel)clamp(x, 0.0f, 255.0f); } //computed value back to the channel range
+};
+
+//4 bytes per pixel, r g b a
+template <> struct PixelTraits<ColorRGBA>
+{
+	typedef unsigned char Channel;
+	typedef int Accumulator;
+	static const unsigned int color_channels = 3;
+	static const bool has_alpha = true;
+	static Channel maxValue() { return 255; }
+	static Channel fromFloat(float x) { return (Channel)clamp(x, 0.0f, 255.0f); }
+};
+
+//1 byte per pixel
+template <> struct PixelTraits<ColorGray8>
+{
+	typedef unsigned char Channel;
+	typedef int Accumulator;
+	static const unsigned int color_channels = 1;
+	static const bool has_alpha = false;
+	static Channel maxValue() { return 255; }
+	static Channel fromFloat(float x) { return (Channel)clamp(x, 0.0f, 255.0f); }
+};
+
+//6 bytes per pixel
+template <> struct PixelTraits<ColorRGB16>
+{
+	typedef unsigned short Channel;
+	typedef int Accumulator;
+	static const unsigned int color_channels = 3;
+	static const bool has_alpha = false;
+	static Channel maxValue() { return 65535; }
+	static Channel fromFloat(float x) { return (Channel)clamp(x, 0.0f, 65535.0f); }
+};
+
+//12 bytes per pixel, values are only clamped below 0
+template <> struct PixelTraits<ColorRGBF32>
+{
+	typedef float Channel;
+	typedef float Accumulator;
+	static const unsigned int color_channels = 3;
+	static const bool has_alpha = false;
+	static Channel maxValue() { return 1.0f; }
+	static Channel fromFloat(float x) { return x < 0.0f ? 0.0f : x; }
+};
+
+// Channel conversions (8 and 16 bit values are rounded, floats clamped to [0,1])
+inline void convertChannel(unsigned char src, unsigned char& dst) { dst = src; }
+inline void convertChannel(unsigned char src, unsigned short& dst) { dst = (unsigned short)(src * 257); }
+inline void convertChannel(unsigned char src, float& dst) { dst = src / 255.0f; }
+inline void convertChannel(unsigned short src, unsigned char& dst) { dst = (unsigned char)((src * 255u + 32895u) >> 16); }
+inline void convertChannel(unsigned short src, unsigned short& dst) { dst = src; }
+inline void convertChannel(unsigned short src, float& dst) { dst = src / 65535.0f; }
+inline void convertChannel(float src, unsigned char& dst) { dst = (unsigned char)(clamp(src, 0.0f, 1.0f) * 255.0f + 0.5f); }
+inline void convertChannel(float src, unsigned short& dst) { dst = (unsigned short)(clamp(src, 0.0f, 1.0f) * 65535.0f + 0.5f); }
+inline void convertChannel(float src, float& dst) { dst = src; }
+
+// Pixel conversions (alpha is opaque when the source has none)
+// Every pair of formats gets its own kernel: the channel counts and types are known at compile time
+// Color to gray uses the same mean as the grayscale filter, gray to color repeats the value
+template <typename SrcT, typename DstT>
+inline void convertPixel(const SrcT& src, DstT& dst)
+{
+	typedef PixelTraits<SrcT> Src;
+	typedef PixelTraits<DstT> Dst;
+
+	if (Src::color_channels == Dst::color_channels)
+		for (unsigned int i = 0; i < Dst::color_channels; ++i)
+			convertChannel(src.v[i], dst.v[i]);
+	else if (Dst::color_channels == 1)
+	{
+		typename Src::Accumulator sum = 0;
+		for (unsigned int i = 0; i < Src::color_channels; ++i)
+			sum += src.v[i];
+		convertChannel((typename Src::Channel)(sum / (typename Src::Accumulator)Src::color_channels), dst.v[0]);
+	}
+	else
+		for (unsigned int i = 0; i < Dst::color_channels; ++i)
+			convertChannel(src.v[0], dst.v[i]);
+
+	if (Dst::has_alpha)
+	{
+		if (Src::has_alpha)
+			convertChannel(src.v[Src::color_channels], dst.v[Dst::color_channels]);
+		else
+			dst.v[Dst::color_channels] = Dst::maxValue();
+	}
+}
+
+template <typename PixelT>
+inline void convertPixel(const PixelT& src, PixelT& dst) { dst = src; }
+
+inline void convertPixel(const Color& src, ColorRGBA& dst) { dst = ColorRGBA(src); }
+inline void convertPixel(const ColorRGBA& src, Color& dst) { dst = src.toColor(); }
+
+#endif
@@ -0,0 +1,609 @@
+#include "raster.h"
+#include <limits>
+
+static const int SUBPIXEL_BITS = 8; //precision of the triangle vertices
+static const long long SUBPIXEL_ONE = 1LL << SUBPIXEL_BITS;
+static const int TILE_SIZE = 8; //side of the tiles tested against the edges as a whole
+static const int PARALLEL_TILE_SIZE = 64; //side of the blocks of tiles given to every thread
+static const int PARALLEL_MIN_AREA = 128 * 128; //smaller shapes are drawn by the calling thread
+static const float MAX_COORDINATE = 1 << 22; //shapes beyond it are not drawn, so the fixed point values can not overflow
+
+// Half-space function of the edge a->b, linear in the pixel position: 0 on the edge and positive on the inner side
+struct EdgeFunction
+{
+	long long origin; //value at the centre of pixel (0,0)
+	long long step_x, step_y; //change from a pixel to the next one along each axis
+	long long bias; //1 when the pixels with their centre on the edge belong to the triangle at the other side
+
+	void setup(long long ax, long long ay, long long bx, long long by)
+	{
+		//(b - a) x (p - a), the edges at the top or the left of the shape keep the centres on them
+		const long long dx = bx - ax, dy = by - ay;
+		step_x = -dy * SUBPIXEL_ONE;
+		step_y = dx * SUBPIXEL_ONE;
+		origin = dx * (SUBPIXEL_ONE / 2 - ay) - dy * (SUBPIXEL_ONE / 2 - ax);
+		bias = (dy < 0 || (dy == 0 && dx > 0)) ? 0 : 1;
+	}
+
+	long long at(int x, int y) const { return origin + step_x * x + step_y * y; }
+	long long test(int x, int y) const { return at(x, y) - bias; } //pixel inside when >= 0
+};
+
+// One color for the whole shape
+template <typename PixelT>
+struct FlatShader
+{
+	PixelT color;
+
+	void operator()(PixelT* row, int x_begin, int x_end, int /*y*/) const { std::fill(row + x_begin, row + x_end, color); }
+};
+
+// Every channel is a plane over the pixels: the value at the centre of pixel (0,0) and the change along each axis
+template <typename PixelT>
+struct GradientShader
+{
+	float base[4], step_x[4], step_y[4];
+
+	void operator()(PixelT* row, int x_begin, int x_end, int y) const
+	{
+		typedef PixelTraits<PixelT> Traits;
+		const unsigned int channels = Traits::color_channels + (Traits::has_alpha ? 1 : 0);
+		const float rounding = std::numeric_limits<typename Traits::Channel>::is_integer ? 0.5f : 0.0f;
+		float values[4];
+		for (unsigned int c = 0; c < channels; ++c)
+			values[c] = base[c] + step_x[c] * x_begin + step_y[c] * y + rounding;
+		for (int x = x_begin; x < x_end; ++x)
+			for (unsigned int c = 0; c < channels; ++c) {
+				row[x].v[c] = Traits::fromFloat(values[c]);
+				values[c] += step_x[c];
+			}
+	}
+};
+
+// Pixels inside the three edges (clockwise on screen, y goes down) of the area [x_min,x_max) x [y_min,y_max), handed to shader by runs
+template <typename PixelT, typename Shader>
+static void rasterTriangle(const ImageViewT<PixelT>& dst, const EdgeFunction* edges, int x_min, int y_min, int x_max, int y_max, const Shader& shader)
+{
+	//the tiles are aligned to the image, cut to the area
+	auto drawTiles = [&](int area_x0, int area_y0, int area_x1, int area_y1) {
+		for (int ty = area_y0; ty < area_y1; ty += TILE_SIZE)
+		for (int tx = area_x0; tx < area_x1; tx += TILE_SIZE)
+		{
+			const int x0 = std::max(tx, x_min), x1 = std::min(tx + TILE_SIZE, x_max);
+			const int y0 = std::max(ty, y_min), y1 = std::min(ty + TILE_SIZE, y_max);
+			if (x0 >= x1 || y0 >= y1)
+				continue;
+
+			//the functions are linear, so their extremes in the tile are at its corner pixels
+			bool inside = true, outside = false;
+			for (int i = 0; i < 3 && !outside; ++i) {
+				const long long a = edges[i].test(x0, y0), b = edges[i].test(x1 - 1, y0);
+				const long long c = edges[i].test(x0, y1 - 1), d = edges[i].test(x1 - 1, y1 - 1);
+				outside = std::max(std::max(a, b), std::max(c, d)) < 0;
+				inside = inside && std::min(std::min(a, b), std::min(c, d)) >= 0;
+			}
+			if (outside)
+				continue;
+			if (inside) {
+				for (int y = y0; y < y1; ++y)
+					shader(dst.getRow(y), x0, x1, y);
+				continue;
+			}
+
+			//the pixels inside a convex shape are consecutive in every row
+			for (int y = y0; y < y1; ++y)
+			{
+				long long e0 = edges[0].test(x0, y), e1 = edges[1].test(x0, y), e2 = edges[2].test(x0, y);
+				int first = -1, last = x1;
+				for (int x = x0; x < x1; ++x) {
+					const bool pixel_inside = (e0 | e1 | e2) >= 0; //no sign bit in any of them
+					if (pixel_inside && first < 0)
+						first = x;
+					else if (!pixel_inside && first >= 0) {
+						last = x;
+						break;
+					}
+					e0 += edges[0].step_x; e1 += edges[1].step_x; e2 += edges[2].step_x;
+				}
+				if (first >= 0)
+					shader(dst.getRow(y), first, last, y);
+			}
+		}
+	};
+
+	const int tiles_x0 = x_min - x_min % TILE_SIZE, tiles_y0 = y_min - y_min % TILE_SIZE;
+	if ((long long)(x_max - x_min) * (y_max - y_min) < PARALLEL_MIN_AREA) {
+		drawTiles(tiles_x0, tiles_y0, x_max, y_max);
+		return;
+	}
+	parallelForTiles(x_max - tiles_x0, y_max - tiles_y0, PARALLEL_TILE_SIZE, [&](unsigned int x_begin, unsigned int y_begin, unsigned int x_end, unsigned int y_end) {
+		drawTiles(tiles_x0 + x_begin, tiles_y0 + y_begin, tiles_x0 + x_end, tiles_y0 + y_end);
+	});
+}
+
+// Sets up the edges of the triangle and the area it covers in dst, false when nothing is drawn
+// The vertices are swapped to the winding the edges expect, and colors (if any) with them
+template <typename PixelT>
+static bool setupTriangle(const ImageViewT<PixelT>& dst, Vector2 p0, Vector2 p1, Vector2 p2, PixelT* colors,
+	EdgeFunction* edges, long long& area, int& x_min, int& y_min, int& x_max, int& y_max)
+{
+	const Vector2* points[3] = { &p0, &p1, &p2 };
+	for (int i = 0; i < 3; ++i)
+		if (!(fabs(points[i]->x) < MAX_COORDINATE && fabs(points[i]->y) < MAX_COORDINATE))
+			return false;
+	if (dst.isEmpty())
+		return false;
+
+	long long x[3], y[3];
+	for (int i = 0; i < 3; ++i) {
+		x[i] = (long long)floor(points[i]->x * SUBPIXEL_ONE + 0.5f);
+		y[i] = (long long)floor(points[i]->y * SUBPIXEL_ONE + 0.5f);
+	}
+	area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0)
+		return false;
+	if (area < 0) {
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		if (colors)
+			std::swap(colors[1], colors[2]);
+		area = -area;
+	}
+
+	//edge i is the one in front of vertex i
+	edges[0].setup(x[1], y[1], x[2], y[2]);
+	edges[1].setup(x[2], y[2], x[0], y[0]);
+	edges[2].setup(x[0], y[0], x[1], y[1]);
+
+	//pixels whose centre can be inside, clipped to dst
+	const long long half = SUBPIXEL_ONE / 2;
+	x_min = (int)std::max((std::min(std::min(x[0], x[1]), x[2]) - half) >> SUBPIXEL_BITS, 0LL);
+	y_min = (int)std::max((std::min(std::min(y[0], y[1]), y[2]) - half) >> SUBPIXEL_BITS, 0LL);
+	x_max = (int)std::min(((std::max(std::max(x[0], x[1]), x[2]) - half) >> SUBPIXEL_BITS) + 1, (long long)dst.width);
+	y_max = (int)std::min(((std::max(std::max(y[0], y[1]), y[2]) - half) >> SUBPIXEL_BITS) + 1, (long long)dst.height);
+	return x_min < x_max && y_min < y_max;
+}
+
+template <typename PixelT>
+void fillTriangle(const ImageViewT<PixelT>& dst, const Vector2& p0, const Vector2& p1, const Vector2& p2, const PixelT& c)
+{
+	EdgeFunction edges[3];
+	long long area;
+	int x_min, y_min, x_max, y_max;
+	if (!setupTriangle<PixelT>(dst, p0, p1, p2, NULL, edges, area, x_min, y_min, x_max, y_max))
+		return;
+
+	FlatShader<PixelT> shader;
+	shader.color = c;
+	rasterTriangle(dst, edges, x_min, y_min, x_max, y_max, shader);
+}
+
+template <typename PixelT>
+void fillTriangle(const ImageViewT<PixelT>& dst, const Vector2& p0, const Vector2& p1, const Vector2& p2,
+	const PixelT& c0, const PixelT& c1, const PixelT& c2)
+{
+	typedef PixelTraits<PixelT> Traits;
+	EdgeFunction edges[3];
+	long long area;
+	int x_min, y_min, x_max, y_max;
+	PixelT colors[3] = { c0, c1, c2 };
+	if (!setupTriangle(dst, p0, p1, p2, colors, edges, area, x_min, y_min, x_max, y_max))
+		return;
+
+	//the weight of every vertex is the function of the edge in front of it over the area, a plane too
+	GradientShader<PixelT> shader;
+	const unsigned int channels = Traits::color_channels + (Traits::has_alpha ? 1 : 0);
+	for (unsigned int c = 0; c < channels; ++c) {
+		double base = 0, step_x = 0, step_y = 0;
+		for (int i = 0; i < 3; ++i) {
+			base += (double)edges[i].origin * colors[i].v[c];
+			step_x += (double)edges[i].step_x * colors[i].v[c];
+			step_y += (double)edges[i].step_y * colors[i].v[c];
+		}
+		shader.base[c] = (float)(base / area);
+		shader.step_x[c] = (float)(step_x / area);
+		shader.step_y[c] = (float)(step_y / area);
+	}
+	rasterTriangle(dst, edges, x_min, y_min, x_max, y_max, shader);
+}
+
+// Edge of a polygon crossing the centres of the rows [first_row, end_row)
+struct ScanEdge
+{
+	int first_row, end_row;
+	long long x; //x where the edge crosses the centre of first_row, 32.32 fixed point
+	long long step; //change of x from a row to the next one
+
+	bool operator<(const ScanEdge& other) const { return first_row < other.first_row; }
+};
+
+// Edge table of the polygon through points for rows of 1 / rows_per_pixel pixels, sorted by their first row
+// Empty when the polygon crosses no row or is too far to be drawn
+static std::vector<ScanEdge> buildEdgeTable(const std::vector<Vector2>& points, int rows_per_pixel)
+{
+	const double one = 4294967296.0; //1 in 32.32
+	std::vector<ScanEdge> edges;
+	for (size_t i = 0; i < points.size(); ++i)
+		if (!(fabs(points[i].x) < MAX_COORDINATE && fabs(points[i].y) < MAX_COORDINATE))
+			return edges;
+
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		Vector2 top = points[i], bottom = points[(i + 1) % points.size()];
+		if (top.y > bottom.y)
+			std::swap(top, bottom);
+		const double top_y = (double)top.y * rows_per_pixel, bottom_y = (double)bottom.y * rows_per_pixel;
+		ScanEdge edge;
+		edge.first_row = (int)ceil(top_y - 0.5);
+		edge.end_row = (int)ceil(bottom_y - 0.5);
+		if (edge.first_row >= edge.end_row)
+			continue; //crosses no centre, horizontal ones included
+		const double slope = ((double)bottom.x - top.x) / (bottom_y - top_y);
+		edge.x = (long long)((top.x + (edge.first_row + 0.5 - top_y) * slope) * one);
+		edge.step = (long long)(slope * one);
+		edges.push_back(edge);
+	}
+	std::stable_sort(edges.begin(), edges.end());
+	return edges;
+}
+
+// Edges of a table crossing the current row, in x order
+struct ActiveEdges
+{
+	const std::vector<ScanEdge>& edges;
+	size_t next; //first edge of the table not added yet
+	std::vector<ScanEdge> active;
+
+	explicit ActiveEdges(const std::vector<ScanEdge>& edges) : edges(edges), next(0) {}
+
+	// Moves to the row y, below the previous one, starting with the edges already crossing it
+	void moveTo(int y)
+	{
+		for (; next < edges.size() && edges[next].first_row <= y; ++next)
+			if (edges[next].end_row > y) {
+				ScanEdge edge = edges[next];
+				edge.x += edge.step * (y - edge.first_row);
+				active.push_back(edge);
+			}
+		active.erase(std::remove_if(active.begin(), active.end(), [y](const ScanEdge& edge) { return edge.end_row <= y; }), active.end());
+
+		//the order changes little from a row to the next one, so insertion sort by x
+		for (size_t i = 1; i < active.size(); ++i)
+			for (size_t j = i; j > 0 && active[j].x < active[j - 1].x; --j)
+				std::swap(active[j], active[j - 1]);
+	}
+
+	// Moves the crossings to the next row
+	void step()
+	{
+		for (size_t i = 0; i < active.size(); ++i)
+			active[i].x += active[i].step;
+	}
+};
+
+// Rows [y_min,y_max) of dst crossed by the edges, false when there are none
+static bool edgeTableRows(const std::vector<ScanEdge>& edges, int rows_per_pixel, int height, int& y_min, int& y_max)
+{
+	if (edges.empty())
+		return false;
+	int first = edges[0].first_row, end = edges[0].end_row;
+	for (size_t i = 1; i < edges.size(); ++i)
+		end = std::max(end, edges[i].end_row);
+	y_min = std::max((int)floor(first / (double)rows_per_pixel), 0);
+	y_max = std::min((int)ceil(end / (double)rows_per_pixel), height);
+	return y_min < y_max;
+}
+
+template <typename PixelT>
+void fillPolygon(const ImageViewT<PixelT>& dst, const std::vector<Vector2>& points, const PixelT& c)
+{
+	if (points.size() < 3 || dst.isEmpty())
+		return;
+	const std::vector<ScanEdge> edges = buildEdgeTable(points, 1);
+	int y_min, y_max;
+	if (!edgeTableRows(edges, 1, dst.height, y_min, y_max))
+		return;
+
+	//every band of rows builds its own active edges
+	auto drawRows = [&](unsigned int row_begin, unsigned int row_end) {
+		ActiveEdges crossings(edges);
+		for (int y = y_min + row_begin; y < y_min + (int)row_end; ++y)
+		{
+			crossings.moveTo(y);
+
+			//even-odd rule: inside between every pair of crossings, for the pixels whose centre is in [left, right)
+			const std::vector<ScanEdge>& active = crossings.active;
+			const long long half = 1LL << 31;
+			for (size_t i = 0; i + 1 < active.size(); i += 2) {
+				const long long first = (active[i].x - half + (1LL << 32) - 1) >> 32;
+				const long long end = (active[i + 1].x - half + (1LL << 32) - 1) >> 32;
+				if (first < end)
+					dst.fillSpan((int)std::max(first, -1LL), (int)std::min(end - 1, (long long)dst.width), y, c);
+			}
+			crossings.step();
+		}
+	};
+
+	if ((long long)(y_max - y_min) * dst.width < PARALLEL_MIN_AREA)
+		drawRows(0, y_max - y_min);
+	else
+		parallelForRows(y_max - y_min, drawRows);
+}
+
+// Anti-aliased shapes
+
+// Moves dst towards c by coverage / 256, in integers for the integer channels
+template <typename PixelT>
+static inline void blendPixel(PixelT& dst, const PixelT& c, int coverage)
+{
+	typedef PixelTraits<PixelT> Traits;
+	typedef typename Traits::Channel Channel;
+	const unsigned int channels = Traits::color_channels + (Traits::has_alpha ? 1 : 0);
+	if (std::numeric_limits<Channel>::is_integer)
+		for (unsigned int i = 0; i < channels; ++i)
+			dst.v[i] = (Channel)(dst.v[i] + ((((int)c.v[i] - (int)dst.v[i]) * coverage + 128) >> 8));
+	else
+		for (unsigned int i = 0; i < channels; ++i)
+			dst.v[i] = (Channel)(dst.v[i] + (c.v[i] - dst.v[i]) * (coverage * (1.0f / 256)));
+}
+
+// Coverage in [0,1] to the 1/256 steps of blendPixel
+static inline int coverageSteps(double coverage)
+{
+	return coverage <= 0 ? 0 : (coverage >= 1 ? 256 : (int)(coverage * 256 + 0.5));
+}
+
+template <typename PixelT>
+void strokeLineAA(const ImageViewT<PixelT>& dst, const Vector2& p0, const Vector2& p1, const PixelT& c)
+{
+	if (dst.isEmpty() || !(fabs(p0.x) < MAX_COORDINATE && fabs(p0.y) < MAX_COORDINATE && fabs(p1.x) < MAX_COORDINATE && fabs(p1.y) < MAX_COORDINATE))
+		return;
+
+	//the centres of the pixels at integer positions, walking along the major axis from left to right
+	double x0 = p0.x - 0.5, y0 = p0.y - 0.5, x1 = p1.x - 0.5, y1 = p1.y - 0.5;
+	const bool steep = fabs(y1 - y0) > fabs(x1 - x0);
+	if (steep) { std::swap(x0, y0); std::swap(x1, y1); }
+	if (x0 > x1) { std::swap(x0, x1); std::swap(y0, y1); }
+	const double gradient = x1 > x0 ? (y1 - y0) / (x1 - x0) : 1;
+	const int major_size = steep ? dst.height : dst.width, minor_size = steep ? dst.width : dst.height;
+
+	auto plot = [&](int major, int minor, int coverage) {
+		if (coverage > 0 && major >= 0 && major < major_size && minor >= 0 && minor < minor_size)
+			blendPixel(steep ? dst.getPixelRef(minor, major) : dst.getPixelRef(major, minor), c, coverage);
+	};
+
+	//the ends cover their pixel by the part of it the line reaches
+	auto plotEnd = [&](double x, double y, double gap) {
+		const double major = floor(x + 0.5), minor = y + gradient * (major - x);
+		const double fraction = minor - floor(minor);
+		plot((int)major, (int)floor(minor), coverageSteps((1 - fraction) * gap));
+		plot((int)major, (int)floor(minor) + 1, coverageSteps(fraction * gap));
+		return (int)major;
+	};
+	const int first = plotEnd(x0, y0, 1 - (x0 + 0.5 - floor(x0 + 0.5)));
+	const int last = plotEnd(x1, y1, x1 + 0.5 - floor(x1 + 0.5));
+
+	//every step in between splits the line between the two pixels around it, y in 16.16 fixed point
+	//y starts at the first step even when it is clipped, so a clipped line has the pixels of the whole one
+	const int begin = std::max(first + 1, 0), end = std::min(last, major_size);
+	if (begin >= end)
+		return;
+	const long long step = (long long)floor(gradient * 65536 + 0.5);
+	long long y = (long long)floor((y0 + gradient * (first + 1 - x0)) * 65536) + (long long)(begin - first - 1) * step;
+	const std::ptrdiff_t major_offset = steep ? dst.stride : 1, minor_offset = steep ? 1 : dst.stride;
+	for (int x = begin; x < end; ++x, y += step) {
+		const int minor = (int)(y >> 16), coverage = (int)((y & 0xFFFF) >> 8);
+		const std::ptrdiff_t offset = x * major_offset + minor * minor_offset;
+		if ((unsigned int)minor < (unsigned int)minor_size)
+			blendPixel(dst.pixels[offset], c, 256 - coverage);
+		if ((unsigned int)(minor + 1) < (unsigned int)minor_size)
+			blendPixel(dst.pixels[offset + minor_offset], c, coverage);
+	}
+}
+
+// Disc (fill) or ring 1 pixel wide centred on the circle, every pixel covered by the distance of its centre to the circle
+template <typename PixelT>
+static void circleAA(const ImageViewT<PixelT>& dst, const Vector2& center, float radius, const PixelT& c, bool fill)
+{
+	if (!(radius > 0) || dst.isEmpty() || !(fabs(center.x) < MAX_COORDINATE && fabs(center.y) < MAX_COORDINATE && radius < MAX_COORDINATE))
+		return;
+
+	//the pixels closer than inner to the centre are fully inside (disc) or untouched (ring), the ones past outer untouched
+	const double outer = fill ? radius + 0.5 : radius + 1.0, inner = fill ? radius - 0.5 : radius - 1.0;
+	auto coverage = [&](double dx, double dy) {
+		const double distance = sqrt(dx * dx + dy * dy) - radius;
+		return coverageSteps(fill ? 0.5 - distance : 1 - fabs(distance));
+	};
+
+	const int y_begin = std::max((int)floor(center.y - outer), 0), y_end = std::min((int)ceil(center.y + outer) + 1, (int)dst.height);
+	for (int y = y_begin; y < y_end; ++y)
+	{
+		const double dy = y + 0.5 - center.y;
+		if (fabs(dy) >= outer)
+			continue;
+		PixelT* row = dst.getRow(y);
+		auto blendRange = [&](int x_begin, int x_end) {
+			for (int x = std::max(x_begin, 0); x < std::min(x_end, (int)dst.width); ++x) {
+				const int cover = coverage(x + 0.5 - center.x, dy);
+				if (cover == 256 && fill)
+					row[x] = c;
+				else if (cover > 0)
+					blendPixel(row[x], c, cover);
+			}
+		};
+
+		//pixels whose centre is at [-half, half] from the centre along x
+		const double outer_half = sqrt(outer * outer - dy * dy);
+		const int outer_begin = (int)ceil(center.x - outer_half - 0.5), outer_end = (int)floor(center.x + outer_half - 0.5) + 1;
+		if (inner <= fabs(dy)) {
+			blendRange(outer_begin, outer_end);
+			continue;
+		}
+		const double inner_half = sqrt(inner * inner - dy * dy);
+		const int inner_begin = (int)ceil(center.x - inner_half - 0.5), inner_end = (int)floor(center.x + inner_half - 0.5) + 1;
+		blendRange(outer_begin, inner_begin);
+		if (fill)
+			dst.fillSpan(inner_begin, inner_end - 1, y, c);
+		blendRange(inner_end, outer_end);
+	}
+}
+
+template <typename PixelT>
+void fillCircleAA(const ImageViewT<PixelT>& dst, const Vector2& center, float radius, const PixelT& c)
+{
+	circleAA(dst, center, radius, c, true);
+}
+
+template <typename PixelT>
+void strokeCircleAA(const ImageViewT<PixelT>& dst, const Vector2& center, float radius, const PixelT& c)
+{
+	circleAA(dst, center, radius, c, false);
+}
+
+template <typename PixelT>
+void fillRectAA(const ImageViewT<PixelT>& dst, float x, float y, float w, float h, const PixelT& c)
+{
+	if (w < 0) { x += w; w = -w; }
+	if (h < 0) { y += h; h = -h; }
+	const double x0 = std::max((double)x, 0.0), x1 = std::min((double)x + w, (double)dst.width);
+	const double y0 = std::max((double)y, 0.0), y1 = std::min((double)y + h, (double)dst.height);
+	if (!(x0 < x1 && y0 < y1))
+		return;
+
+	//the part of a pixel inside is the product of the parts of its column and its row
+	auto overlap = [](double begin, double end, int pixel) { return std::min(end, pixel + 1.0) - std::max(begin, (double)pixel); };
+	const int column_begin = (int)floor(x0), column_end = (int)ceil(x1);
+	const int full_begin = (int)ceil(x0), full_end = (int)floor(x1); //columns fully inside
+	for (int row = (int)floor(y0); row < (int)ceil(y1); ++row)
+	{
+		const double row_part = overlap(y0, y1, row);
+		PixelT* pixels = dst.getRow(row);
+		if (row_part >= 1 && full_begin < full_end) {
+			dst.fillSpan(full_begin, full_end - 1, row, c);
+			if (column_begin < full_begin)
+				blendPixel(pixels[column_begin], c, coverageSteps(overlap(x0, x1, column_begin)));
+			if (full_end < column_end)
+				blendPixel(pixels[full_end], c, coverageSteps(overlap(x0, x1, full_end)));
+			continue;
+		}
+		for (int column = column_begin; column < column_end; ++column)
+			blendPixel(pixels[column], c, coverageSteps(overlap(x0, x1, column) * row_part));
+	}
+}
+
+template <typename PixelT>
+void fillPolygonAA(const ImageViewT<PixelT>& dst, const std::vector<Vector2>& points, const PixelT& c)
+{
+	const int rows_per_pixel = 4; //sample rows, each one exact along x
+	if (points.size() < 3 || dst.isEmpty())
+		return;
+	const std::vector<ScanEdge> edges = buildEdgeTable(points, rows_per_pixel);
+	int y_min, y_max;
+	if (!edgeTableRows(edges, rows_per_pixel, dst.height, y_min, y_max))
+		return;
+
+	auto drawRows = [&](unsigned int row_begin, unsigned int row_end) {
+		//coverage of every pixel of the row in 1/256 of a pixel per sample row: the parts of the pixels at the ends
+		//of the spans, and the whole pixels between them as steps at their ends (summed across the row later)
+		std::vector<int> partial(dst.width + 1, 0), steps(dst.width + 1, 0);
+		ActiveEdges crossings(edges);
+		for (int y = y_min + row_begin; y < y_min + (int)row_end; ++y)
+		{
+			int x_first = dst.width, x_end = 0;
+			for (int sample = 0; sample < rows_per_pixel; ++sample)
+			{
+				crossings.moveTo(y * rows_per_pixel + sample);
+				const std::vector<ScanEdge>& active = crossings.active;
+				for (size_t i = 0; i + 1 < active.size(); i += 2)
+				{
+					//even-odd rule, the span in 1/256 of a pixel cut to the row
+					const long long left = std::max(active[i].x >> 24, 0LL);
+					const long long right = std::min(active[i + 1].x >> 24, (long long)dst.width * 256);
+					if (left >= right)
+						continue;
+					const int first = (int)(left >> 8), last = (int)(right >> 8);
+					if (first == last)
+						partial[first] += (int)(right - left);
+					else {
+						partial[first] += 256 - (int)(left & 255);
+						steps[first + 1] += 256;
+						steps[last] -= 256;
+						partial[last] += (int)(right & 255);
+					}
+					x_first = std::min(x_first, first);
+					x_end = std::max(x_end, last + 1);
+				}
+				crossings.step();
+			}
+
+			PixelT* row = dst.getRow(y);
+			int whole = 0;
+			x_end = std::min(x_end, (int)dst.width);
+			for (int x = x_first; x < x_end; ++x) {
+				whole += steps[x];
+				const int coverage = (whole + partial[x]) / rows_per_pixel;
+				if (coverage >= 256)
+					row[x] = c;
+				else if (coverage > 0)
+					blendPixel(row[x], c, coverage);
+				partial[x] = steps[x] = 0;
+			}
+			if (x_end < (int)partial.size())
+				partial[x_end] = steps[x_end] = 0;
+		}
+	};
+
+	if ((long long)(y_max - y_min) * dst.width < PARALLEL_MIN_AREA)
+		drawRows(0, y_max - y_min);
+	else
+		parallelForRows(y_max - y_min, drawRows);
+}
+
+// Pixel types the rasteriser can be instantiated with
+template void fillTriangle(const ImageViewT<ColorGray8>&, const Vector2&, const Vector2&, const Vector2&, const ColorGray8&);
+template void fillTriangle(const ImageViewT<Color>&, const Vector2&, const Vector2&, const Vector2&, const Color&);
+template void fillTriangle(const ImageViewT<ColorRGBA>&, const Vector2&, const Vector2&, const Vector2&, const ColorRGBA&);
+template void fillTriangle(const ImageViewT<ColorRGB16>&, const Vector2&, const Vector2&, const Vector2&, const ColorRGB16&);
+template void fillTriangle(const ImageViewT<ColorRGBF32>&, const Vector2&, const Vector2&, const Vector2&, const ColorRGBF32&);
+
+template void fillTriangle(const ImageViewT<ColorGray8>&, const Vector2&, const Vector2&, const Vector2&, const ColorGray8&, const ColorGray8&, const ColorGray8&);
+template void fillTriangle(const ImageViewT<Color>&, const Vector2&, const Vector2&, const Vector2&, const Color&, const Color&, const Color&);
+template void fillTriangle(const ImageViewT<ColorRGBA>&, const Vector2&, const Vector2&, const Vector2&, const ColorRGBA&, const ColorRGBA&, const ColorRGBA&);
+template void fillTriangle(const ImageViewT<ColorRGB16>&, const Vector2&, const Vector2&, const Vector2&, const ColorRGB16&, const ColorRGB16&, const ColorRGB16&);
+template void fillTriangle(const ImageViewT<ColorRGBF32>&, const Vector2&, const Vector2&, const Vector2&, const ColorRGBF32&, const ColorRGBF32&, const ColorRGBF32&);
+
+template void fillPolygon(const ImageViewT<ColorGray8>&, const std::vector<Vector2>&, const ColorGray8&);
+template void fillPolygon(const ImageViewT<Color>&, const std::vector<Vector2>&, const Color&);
+template void fillPolygon(const ImageViewT<ColorRGBA>&, const std::vector<Vector2>&, const ColorRGBA&);
+template void fillPolygon(const ImageViewT<ColorRGB16>&, const std::vector<Vector2>&, const ColorRGB16&);
+template void fillPolygon(const ImageViewT<ColorRGBF32>&, const std::vector<Vector2>&, const ColorRGBF32&);
+
+template void strokeLineAA(const ImageViewT<ColorGray8>&, const Vector2&, const Vector2&, const ColorGray8&);
+template void strokeLineAA(const ImageViewT<Color>&, const Vector2&, const Vector2&, const Color&);
+template void strokeLineAA(const ImageViewT<ColorRGBA>&, const Vector2&, const Vector2&, const ColorRGBA&);
+template void strokeLineAA(const ImageViewT<ColorRGB16>&, const Vector2&, const Vector2&, const ColorRGB16&);
+template void strokeLineAA(const ImageViewT<ColorRGBF32>&, const Vector2&, const Vector2&, const ColorRGBF32&);
+
+template void fillCircleAA(const ImageViewT<ColorGray8>&, const Vector2&, float, const ColorGray8&);
+template void fillCircleAA(const ImageViewT<Color>&, const Vector2&, float, const Color&);
+template void fillCircleAA(const ImageViewT<ColorRGBA>&, const Vector2&, float, const ColorRGBA&);
+template void fillCircleAA(const ImageViewT<ColorRGB16>&, const Vector2&, float, const ColorRGB16&);
+template void fillCircleAA(const ImageViewT<ColorRGBF32>&, const Vector2&, float, const ColorRGBF32&);
+
+template void strokeCircleAA(const ImageViewT<ColorGray8>&, const Vector2&, float, const ColorGray8&);
+template void strokeCircleAA(const ImageViewT<Color>&, const Vector2&, float, const Color&);
+template void strokeCircleAA(const ImageViewT<ColorRGBA>&, const Vector2&, float, const ColorRGBA&);
+template void strokeCircleAA(const ImageViewT<ColorRGB16>&, const Vector2&, float, const ColorRGB16&);
+template void strokeCircleAA(const ImageViewT<ColorRGBF32>&, const Vector2&, float, const ColorRGBF32&);
+
+template void fillRectAA(const ImageViewT<ColorGray8>&, float, float, float, float, const ColorGray8&);
+template void fillRectAA(const ImageViewT<Color>&, float, float, float, float, const Color&);
+template void fillRectAA(const ImageViewT<ColorRGBA>&, float, float, float, float, const ColorRGBA&);
+template void fillRectAA(const ImageViewT<ColorRGB16>&, float, float, float, float, const ColorRGB16&);
+template void fillRectAA(const ImageViewT<ColorRGBF32>&, float, float, float, float, const ColorRGBF32&);
+
+template void fillPolygonAA(const ImageViewT<ColorGray8>&, const std::vector<Vector2>&, const ColorGray8&);
+template void fillPolygonAA(const ImageViewT<Color>&, const std::vector<Vector2>&, const Color&);
+template void fillPolygonAA(const ImageViewT<ColorRGBA>&, const std::vector<Vector2>&, const ColorRGBA&);
+template void fillPolygonAA(const ImageViewT<ColorRGB16>&, const std::vector<Vector2>&, const ColorRGB16&);
+template void fillPolygonAA(const ImageViewT<ColorRGBF32>&, const std::vector<Vector2>&, const ColorRGBF32&);
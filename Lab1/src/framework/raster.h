@@ -0,0 +1,51 @@
+/*  raster.h
+	Filling of triangles and polygons given in pixel coordinates (the centre of pixel (x,y) is at x + 0.5, y + 0.5).
+	A pixel is drawn when its centre is inside the shape, so shapes sharing an edge never draw a pixel twice.
+	Triangles use the half-space functions of their three edges, which are linear: they are stepped with additions
+	and first evaluated at the corners of 8x8 tiles, so a tile outside an edge is skipped and a tile inside all of
+	them is filled without testing its pixels. Large triangles are split between the worker threads by tiles.
+	Polygons (concave and self-intersecting ones too, with the even-odd rule) are filled by rows with an active
+	edge table: the edges are sorted by their first row and only the ones crossing the current row are kept.
+	The anti-aliased versions blend every pixel with the color by the part of it the shape covers, in steps of 1/256
+	with integer arithmetic for the integer channels, and only the pixels on the edges are blended.
+*/
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "image.h"
+
+// Fills the triangle p0 p1 p2 (either winding) with the color c, clipped to dst
+template <typename PixelT>
+void fillTriangle(const ImageViewT<PixelT>& dst, const Vector2& p0, const Vector2& p1, const Vector2& p2, const PixelT& c);
+
+// Same, with the color of every vertex interpolated across the triangle
+template <typename PixelT>
+void fillTriangle(const ImageViewT<PixelT>& dst, const Vector2& p0, const Vector2& p1, const Vector2& p2,
+	const PixelT& c0, const PixelT& c1, const PixelT& c2);
+
+// Fills the polygon through points (closed from the last to the first one) with the color c, clipped to dst
+template <typename PixelT>
+void fillPolygon(const ImageViewT<PixelT>& dst, const std::vector<Vector2>& points, const PixelT& c);
+
+// Anti-aliased shapes, stroke draws the outline 1 pixel wide
+
+// Xiaolin Wu line: every step along the major axis shares the line between the two pixels around it, by their distance to it
+template <typename PixelT>
+void strokeLineAA(const ImageViewT<PixelT>& dst, const Vector2& p0, const Vector2& p1, const PixelT& c);
+
+// Every pixel covered by the distance of its centre to the circle
+template <typename PixelT>
+void fillCircleAA(const ImageViewT<PixelT>& dst, const Vector2& center, float radius, const PixelT& c);
+template <typename PixelT>
+void strokeCircleAA(const ImageViewT<PixelT>& dst, const Vector2& center, float radius, const PixelT& c);
+
+// Rectangle from the corner (x,y), every pixel covered by the exact area of its overlap
+template <typename PixelT>
+void fillRectAA(const ImageViewT<PixelT>& dst, float x, float y, float w, float h, const PixelT& c);
+
+// Polygon sampled by 4 rows per pixel row, each one covering its pixels exactly along x
+template <typename PixelT>
+void fillPolygonAA(const ImageViewT<PixelT>& dst, const std::vector<Vector2>& points, const PixelT& c);
+
+#endif
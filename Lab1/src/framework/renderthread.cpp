@@ -0,0 +1,56 @@
+#include "renderthread.h"
+
+RenderThread::RenderThread()
+{
+	busy = false;
+	stopping = false;
+	thread = std::thread(&RenderThread::threadLoop, this);
+}
+
+RenderThread::~RenderThread()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done_condition.wait(lock, [this] { return !busy; });
+		stopping = true;
+	}
+	wake_condition.notify_one();
+	thread.join();
+}
+
+void RenderThread::begin(const std::function<void()>& job)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done_condition.wait(lock, [this] { return !busy; });
+		this->job = job;
+		busy = true;
+	}
+	wake_condition.notify_one();
+}
+
+void RenderThread::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	done_condition.wait(lock, [this] { return !busy; });
+}
+
+void RenderThread::threadLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (1)
+	{
+		wake_condition.wait(lock, [this] { return busy || stopping; });
+		if (!busy)
+			return;
+
+		//the job runs without the lock, so wait() does not block on it
+		lock.unlock();
+		job();
+		lock.lock();
+
+		job = nullptr;
+		busy = false;
+		done_condition.notify_all();
+	}
+}
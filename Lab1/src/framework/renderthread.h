@@ -0,0 +1,41 @@
+/*  renderthread.h
+	A thread that runs one job at a time in the background, used by the pipelined main loop to render the next
+	frame while the main thread (the one with the OpenGL context and the SDL events) presents the current one.
+	begin() hands a job over and returns at once, wait() blocks until it is finished. Everything the job writes
+	is visible to the thread that called wait(), and everything written before begin() is visible to the job.
+*/
+
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class RenderThread
+{
+public:
+	RenderThread();
+	~RenderThread(); //waits for the current job
+
+	// Starts job on the thread (after the previous one is finished)
+	void begin(const std::function<void()>& job);
+
+	// Blocks until the job is done, returns at once when there is none
+	void wait();
+
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake_condition;
+	std::condition_variable done_condition;
+
+	std::function<void()> job;
+	bool busy;
+	bool stopping;
+
+	void threadLoop();
+};
+
+#endif
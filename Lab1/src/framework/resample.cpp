@@ -0,0 +1,217 @@
+#include "resample.h"
+#include "simd.h"
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <limits>
+
+static double sinc(double x)
+{
+	if (x == 0)
+		return 1;
+	x *= PI;
+	return sin(x) / x;
+}
+
+// Distance from the centre beyond which the kernel is 0
+static double kernelSupport(ResampleFilter filter)
+{
+	switch (filter)
+	{
+		case RESAMPLE_BOX: return 0.5;
+		case RESAMPLE_BILINEAR: return 1;
+		case RESAMPLE_BICUBIC: return 2;
+		case RESAMPLE_LANCZOS3: return 3;
+		default: return 0.5;
+	}
+}
+
+static double kernelValue(ResampleFilter filter, double x)
+{
+	x = fabs(x);
+	switch (filter)
+	{
+		case RESAMPLE_BOX:
+			return x < 0.5 ? 1 : 0;
+		case RESAMPLE_BILINEAR:
+			return x < 1 ? 1 - x : 0;
+		case RESAMPLE_BICUBIC:
+		{
+			const double a = -0.5; //Catmull-Rom
+			if (x < 1) return ((a + 2) * x - (a + 3)) * x * x + 1;
+			if (x < 2) return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+			return 0;
+		}
+		case RESAMPLE_LANCZOS3:
+			return x < 3 ? sinc(x) * sinc(x / 3) : 0;
+		default:
+			return 0;
+	}
+}
+
+ResampleWeights::ResampleWeights(unsigned int src_size, unsigned int dst_size, ResampleFilter filter)
+{
+	this->src_size = src_size;
+	this->dst_size = dst_size;
+	this->filter = filter;
+	first.resize(dst_size);
+	count.resize(dst_size);
+
+	//same pixels scale() always picked
+	if (filter == RESAMPLE_NEAREST)
+	{
+		taps = 1;
+		weights.assign(dst_size, 1.0f);
+		for (unsigned int i = 0; i < dst_size; ++i) {
+			first[i] = std::min((unsigned int)(src_size * (i / (float)dst_size)), src_size - 1);
+			count[i] = 1;
+		}
+		return;
+	}
+
+	const double scale = (double)src_size / dst_size;
+	const double stretch = std::max(scale, 1.0); //the kernel covers all the inputs of an output when shrinking
+	const double support = kernelSupport(filter) * stretch;
+	taps = (unsigned int)ceil(support) * 2 + 1;
+	weights.assign(dst_size * taps, 0.0f);
+
+	std::vector<double> values(taps);
+	for (unsigned int i = 0; i < dst_size; ++i)
+	{
+		//centres of the pixels are at +0.5
+		const double center = (i + 0.5) * scale;
+		int lo = std::max((int)floor(center - support + 0.5), 0);
+		int hi = std::min((int)floor(center + support + 0.5), (int)src_size);
+		hi = std::min(hi, lo + (int)taps);
+
+		double total = 0;
+		for (int j = lo; j < hi; ++j)
+			total += values[j - lo] = kernelValue(filter, (j + 0.5 - center) / stretch);
+
+		//skip the zero weights at both ends
+		int begin = 0, end = hi - lo;
+		while (begin < end - 1 && values[begin] == 0) ++begin;
+		while (end > begin + 1 && values[end - 1] == 0) --end;
+
+		first[i] = lo + begin;
+		count[i] = end - begin;
+		float* w = &weights[i * taps];
+		for (int k = begin; k < end; ++k)
+			w[k - begin] = (float)(total != 0 ? values[k] / total : 1.0 / (end - begin));
+	}
+}
+
+std::shared_ptr<const ResampleWeights> ResampleWeights::get(unsigned int src_size, unsigned int dst_size, ResampleFilter filter)
+{
+	static std::mutex mutex;
+	static std::map< std::tuple<unsigned int, unsigned int, int>, std::shared_ptr<const ResampleWeights> > cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	const std::tuple<unsigned int, unsigned int, int> key(src_size, dst_size, (int)filter);
+	auto it = cache.find(key);
+	if (it != cache.end())
+		return it->second;
+
+	//a window being resized asks for new sizes all the time, so the old ones are dropped eventually
+	if (cache.size() >= 64)
+		cache.clear();
+	std::shared_ptr<const ResampleWeights> weights = std::make_shared<const ResampleWeights>(src_size, dst_size, filter);
+	cache[key] = weights;
+	return weights;
+}
+
+// Horizontal pass of one row: out gets weights.dst_size pixels of channels floats
+template <typename PixelT>
+static void resampleRow(const PixelT* in, float* out, const ResampleWeights& weights, unsigned int channels)
+{
+	for (unsigned int x = 0; x < weights.dst_size; ++x)
+	{
+		const float* w = weights.getWeights(x);
+		const PixelT* pixels = in + weights.first[x];
+		float sums[4] = { 0, 0, 0, 0 };
+		for (int k = 0; k < weights.count[x]; ++k)
+			for (unsigned int c = 0; c < channels; ++c)
+				sums[c] += w[k] * pixels[k].v[c];
+		for (unsigned int c = 0; c < channels; ++c)
+			out[x * channels + c] = sums[c];
+	}
+}
+
+// The 8 bit formats have vectorized kernels (see simd.h) that give the same sums
+static void resampleRow(const Color* in, float* out, const ResampleWeights& weights, unsigned int)
+{
+	getPixelKernels().resampleRow(in, out, weights.dst_size, weights.first.data(), weights.count.data(), weights.weights.data(), weights.taps);
+}
+
+static void resampleRow(const ColorRGBA* in, float* out, const ResampleWeights& weights, unsigned int)
+{
+	getPixelKernels().resampleRowRGBA(in, out, weights.dst_size, weights.first.data(), weights.count.data(), weights.weights.data(), weights.taps);
+}
+
+template <typename PixelT>
+void resample(const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst, ResampleFilter filter)
+{
+	typedef PixelTraits<PixelT> Traits;
+	const unsigned int channels = Traits::color_channels + (Traits::has_alpha ? 1 : 0); //alpha is filtered too
+	const float rounding = std::numeric_limits<typename Traits::Channel>::is_integer ? 0.5f : 0.0f;
+
+	if (src.isEmpty() || dst.isEmpty())
+		return;
+
+	const std::shared_ptr<const ResampleWeights> horizontal = ResampleWeights::get(src.width, dst.width, filter);
+	const std::shared_ptr<const ResampleWeights> vertical = ResampleWeights::get(src.height, dst.height, filter);
+
+	//one input pixel per output one, copied as is
+	if (filter == RESAMPLE_NEAREST)
+	{
+		parallelForRows(dst.height, [&](unsigned int y_begin, unsigned int y_end) {
+			for (unsigned int y = y_begin; y < y_end; ++y) {
+				const PixelT* in = src.getRow(vertical->first[y]);
+				PixelT* out = dst.getRow(y);
+				for (unsigned int x = 0; x < dst.width; ++x)
+					out[x] = in[horizontal->first[x]];
+			}
+		});
+		return;
+	}
+
+	//only the input rows some output row reads go through the horizontal pass
+	const unsigned int row_begin = vertical->first[0];
+	const unsigned int row_end = vertical->first[dst.height - 1] + vertical->count[dst.height - 1];
+	const unsigned int row_size = dst.width * channels;
+	std::vector<float> buffer((size_t)row_size * (row_end - row_begin));
+
+	//horizontal pass: input rows to rows of dst.width pixels in float
+	parallelForRows(row_end - row_begin, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y)
+			resampleRow(src.getRow(row_begin + y), &buffer[(size_t)y * row_size], *horizontal, channels);
+	});
+
+	//vertical pass: every output row is a weighted sum of whole buffer rows, so the inner loop is contiguous
+	parallelForRows(dst.height, [&](unsigned int y_begin, unsigned int y_end) {
+		std::vector<float> sums(row_size);
+		for (unsigned int y = y_begin; y < y_end; ++y)
+		{
+			std::fill(sums.begin(), sums.end(), 0.0f);
+			const float* weights = vertical->getWeights(y);
+			for (int k = 0; k < vertical->count[y]; ++k) {
+				const float* row = &buffer[(size_t)(vertical->first[y] + k - row_begin) * row_size];
+				const float weight = weights[k];
+				for (unsigned int i = 0; i < row_size; ++i)
+					sums[i] += weight * row[i];
+			}
+
+			PixelT* out = dst.getRow(y);
+			for (unsigned int x = 0; x < dst.width; ++x)
+				for (unsigned int c = 0; c < channels; ++c)
+					out[x].v[c] = Traits::fromFloat(sums[x * channels + c] + rounding);
+		}
+	});
+}
+
+// Pixel types the resampler can be instantiated with
+template void resample(const ImageViewT<ColorGray8>&, const ImageViewT<ColorGray8>&, ResampleFilter);
+template void resample(const ImageViewT<Color>&, const ImageViewT<Color>&, ResampleFilter);
+template void resample(const ImageViewT<ColorRGBA>&, const ImageViewT<ColorRGBA>&, ResampleFilter);
+template void resample(const ImageViewT<ColorRGB16>&, const ImageViewT<ColorRGB16>&, ResampleFilter);
+template void resample(const ImageViewT<ColorRGBF32>&, const ImageViewT<ColorRGBF32>&, ResampleFilter);
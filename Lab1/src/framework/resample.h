@@ -0,0 +1,39 @@
+/*  resample.h
+	Separable resampling of images with the kernels of ResampleFilter (image.h).
+	An image is resized with a horizontal pass over the rows into a float buffer, then a vertical one
+	into the destination. Every output pixel of a pass is a weighted sum of a few consecutive input ones,
+	and those weights only depend on the two sizes and the kernel, so they are computed once and cached.
+	When shrinking the kernel is stretched over all the pixels an output one covers, so there is no aliasing.
+*/
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "image.h"
+
+//Contribution of the input pixels to every output pixel along one axis
+class ResampleWeights
+{
+public:
+	unsigned int src_size;
+	unsigned int dst_size;
+	ResampleFilter filter;
+	unsigned int taps; //most input pixels an output one reads
+
+	std::vector<int> first; //first input pixel of every output one
+	std::vector<int> count; //inputs read by every output pixel (up to taps, fewer at the borders)
+	std::vector<float> weights; //dst_size * taps, every group adds up to 1
+
+	ResampleWeights(unsigned int src_size, unsigned int dst_size, ResampleFilter filter);
+
+	const float* getWeights(unsigned int i) const { return &weights[i * taps]; }
+
+	// Shared table for a pair of sizes, computed the first time it is asked for
+	static std::shared_ptr<const ResampleWeights> get(unsigned int src_size, unsigned int dst_size, ResampleFilter filter);
+};
+
+// Resizes src into dst (the sizes of both views give the scale), both views must not overlap
+template <typename PixelT>
+void resample(const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst, ResampleFilter filter);
+
+#endif
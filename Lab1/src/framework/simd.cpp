@@ -0,0 +1,797 @@
+#include "simd.h"
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define SIMD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+//gcc and clang need to be told which instruction set each function is allowed to use
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define SIMD_TARGET(isa)
+#endif
+
+// Scalar kernels (reference)
+// gray = (r + g + b) / 3, truncated
+// threshold = 255 if the gray level is above 127 (sum above 381), 0 otherwise
+
+static void grayscaleScalar(Color* pixels, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		Color& c = pixels[i];
+		const unsigned char gray = (unsigned char)((c.r + c.g + c.b) / 3);
+		c.r = c.g = c.b = gray;
+	}
+}
+
+static void thresholdScalar(Color* pixels, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		Color& c = pixels[i];
+		const unsigned char value = (c.r + c.g + c.b) > 381 ? 255 : 0;
+		c.r = c.g = c.b = value;
+	}
+}
+
+static void invertScalar(Color* pixels, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		Color& c = pixels[i];
+		c.r = 255 - c.r;
+		c.g = 255 - c.g;
+		c.b = 255 - c.b;
+	}
+}
+
+// 4 byte pixels use the same formulas, the alpha channel is kept
+
+static void grayscaleRGBAScalar(ColorRGBA* pixels, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		ColorRGBA& c = pixels[i];
+		const unsigned char gray = (unsigned char)((c.r + c.g + c.b) / 3);
+		c.r = c.g = c.b = gray;
+	}
+}
+
+static void thresholdRGBAScalar(ColorRGBA* pixels, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		ColorRGBA& c = pixels[i];
+		const unsigned char value = (c.r + c.g + c.b) > 381 ? 255 : 0;
+		c.r = c.g = c.b = value;
+	}
+}
+
+static void invertRGBAScalar(ColorRGBA* pixels, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		ColorRGBA& c = pixels[i];
+		c.r = 255 - c.r;
+		c.g = 255 - c.g;
+		c.b = 255 - c.b;
+	}
+}
+
+// Lookup of the 3 color channels of 4 byte pixels in per channel tables (see lut.h), alpha is kept.
+// Every output channel reads the input channel source[c], tables[c] holds 32 bit entries with the
+// result already moved to its byte (r << 0, g << 8, b << 16) so the vector versions only need to OR them
+
+static void lookupRGBAScalar(ColorRGBA* pixels, unsigned int count, const unsigned int (*tables)[256], const unsigned char* source)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		ColorRGBA& c = pixels[i];
+		const unsigned char in[3] = { c.r, c.g, c.b };
+		c.r = (unsigned char)tables[0][in[source[0]]];
+		c.g = (unsigned char)(tables[1][in[source[1]]] >> 8);
+		c.b = (unsigned char)(tables[2][in[source[2]]] >> 16);
+	}
+}
+
+// Horizontal pass of the resampler: every output pixel is a weighted sum of a few consecutive input ones,
+// added in order of the inputs in float (so the vector versions give the same sums)
+
+template <typename PixelT>
+static void resampleRowScalar(const PixelT* in, float* out, unsigned int width, const int* first, const int* count, const float* weights, unsigned int taps)
+{
+	const unsigned int channels = sizeof(PixelT);
+	for (unsigned int x = 0; x < width; ++x) {
+		const PixelT* pixels = in + first[x];
+		const float* w = weights + x * taps;
+		float sums[4] = { 0, 0, 0, 0 };
+		for (int k = 0; k < count[x]; ++k)
+			for (unsigned int c = 0; c < channels; ++c)
+				sums[c] += w[k] * pixels[k].v[c];
+		for (unsigned int c = 0; c < channels; ++c)
+			out[x * channels + c] = sums[c];
+	}
+}
+
+#ifdef SIMD_X86
+
+// Vector kernels
+// Pixels are 3 bytes, so instead of deinterleaving the channels every byte computes the sum of the
+// pixel it belongs to: depending on its position inside the pixel (its phase) it adds the next one or
+// two bytes and/or the previous one or two bytes. The phase pattern repeats every 3 vectors, so a
+// block of 3 vectors (16, 32 or 64 pixels) uses a fixed set of masks. The result is written back to
+// every byte, which leaves r = g = b.
+
+#define SIMD_MAX_VECTOR_BYTES 64
+
+//byte masks selecting the neighbours that belong to the same pixel, for a block of 3 vectors
+struct PhaseMasks
+{
+	unsigned char next1[3 * SIMD_MAX_VECTOR_BYTES]; //phase 0 and 1 add the following byte
+	unsigned char next2[3 * SIMD_MAX_VECTOR_BYTES]; //phase 0 adds the byte after that
+	unsigned char prev1[3 * SIMD_MAX_VECTOR_BYTES]; //phase 1 and 2 add the previous byte
+	unsigned char prev2[3 * SIMD_MAX_VECTOR_BYTES]; //phase 2 adds the byte before that
+
+	PhaseMasks()
+	{
+		for (int i = 0; i < 3 * SIMD_MAX_VECTOR_BYTES; ++i) {
+			const int phase = i % 3;
+			next1[i] = phase <= 1 ? 0xFF : 0;
+			next2[i] = phase == 0 ? 0xFF : 0;
+			prev1[i] = phase >= 1 ? 0xFF : 0;
+			prev2[i] = phase == 2 ? 0xFF : 0;
+		}
+	}
+};
+
+static const PhaseMasks phase_masks;
+
+// SSE2: 16 pixels per block
+
+SIMD_TARGET("sse2") static inline void pixelSumsSSE2(const unsigned char* p, int k, __m128i& lo, __m128i& hi)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const int m = k * 16;
+	const __m128i v0 = _mm_loadu_si128((const __m128i*)p);
+	const __m128i n1 = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + 1)), _mm_loadu_si128((const __m128i*)(phase_masks.next1 + m)));
+	const __m128i n2 = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + 2)), _mm_loadu_si128((const __m128i*)(phase_masks.next2 + m)));
+	const __m128i p1 = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p - 1)), _mm_loadu_si128((const __m128i*)(phase_masks.prev1 + m)));
+	const __m128i p2 = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p - 2)), _mm_loadu_si128((const __m128i*)(phase_masks.prev2 + m)));
+
+	lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(v0, zero), _mm_unpacklo_epi8(n1, zero)),
+		_mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(n2, zero), _mm_unpacklo_epi8(p1, zero)), _mm_unpacklo_epi8(p2, zero)));
+	hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(v0, zero), _mm_unpackhi_epi8(n1, zero)),
+		_mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(n2, zero), _mm_unpackhi_epi8(p1, zero)), _mm_unpackhi_epi8(p2, zero)));
+}
+
+SIMD_TARGET("sse2") static void grayscaleSSE2(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m128i div3 = _mm_set1_epi16((short)0xAAAB); //x / 3 == (x * 0xAAAB) >> 17 for 16 bit values
+
+	//the first pixel is left to the scalar kernel so the loads at pos - 2 stay inside the span
+	unsigned int pos = 3;
+	for (; pos + 48 + 2 <= total; pos += 48) {
+		__m128i lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+			pixelSumsSSE2(data + pos + k * 16, k, lo[k], hi[k]);
+		for (int k = 0; k < 3; ++k) {
+			const __m128i gray_lo = _mm_srli_epi16(_mm_mulhi_epu16(lo[k], div3), 1);
+			const __m128i gray_hi = _mm_srli_epi16(_mm_mulhi_epu16(hi[k], div3), 1);
+			_mm_storeu_si128((__m128i*)(data + pos + k * 16), _mm_packus_epi16(gray_lo, gray_hi));
+		}
+	}
+
+	if (count > 0)
+		grayscaleScalar(pixels, 1);
+	if (pos / 3 < count)
+		grayscaleScalar(pixels + pos / 3, count - pos / 3);
+}
+
+SIMD_TARGET("sse2") static void thresholdSSE2(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m128i limit = _mm_set1_epi16(381);
+
+	unsigned int pos = 3;
+	for (; pos + 48 + 2 <= total; pos += 48) {
+		__m128i lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+			pixelSumsSSE2(data + pos + k * 16, k, lo[k], hi[k]);
+		for (int k = 0; k < 3; ++k) {
+			//0xFFFF >> 8 leaves 255 in every pixel above the limit
+			const __m128i value_lo = _mm_srli_epi16(_mm_cmpgt_epi16(lo[k], limit), 8);
+			const __m128i value_hi = _mm_srli_epi16(_mm_cmpgt_epi16(hi[k], limit), 8);
+			_mm_storeu_si128((__m128i*)(data + pos + k * 16), _mm_packus_epi16(value_lo, value_hi));
+		}
+	}
+
+	if (count > 0)
+		thresholdScalar(pixels, 1);
+	if (pos / 3 < count)
+		thresholdScalar(pixels + pos / 3, count - pos / 3);
+}
+
+SIMD_TARGET("sse2") static void invertSSE2(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m128i ones = _mm_set1_epi8((char)0xFF);
+
+	//invert does not depend on the channel, so the span is processed as plain bytes
+	unsigned int pos = 0;
+	for (; pos + 16 <= total; pos += 16)
+		_mm_storeu_si128((__m128i*)(data + pos), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + pos)), ones));
+	for (; pos < total; ++pos)
+		data[pos] = 255 - data[pos];
+}
+
+// 4 byte pixels need no phase masks: every 32 bit lane holds a whole pixel (r in the low byte,
+// alpha in the high one), so the channels are separated with shifts and summed inside the lane.
+// The sums fit in the low word of the lane, which lets the 16 bit multiply divide them by 3.
+
+SIMD_TARGET("sse2") static inline __m128i pixelSumsRGBASSE2(__m128i v)
+{
+	const __m128i byte = _mm_set1_epi32(0xFF);
+	return _mm_add_epi32(_mm_add_epi32(_mm_and_si128(v, byte), _mm_and_si128(_mm_srli_epi32(v, 8), byte)), _mm_and_si128(_mm_srli_epi32(v, 16), byte));
+}
+
+SIMD_TARGET("sse2") static void grayscaleRGBASSE2(ColorRGBA* pixels, unsigned int count)
+{
+	const __m128i div3 = _mm_set1_epi32(0xAAAB); //the high word of every lane is 0 on both sides
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	const unsigned int step = sizeof(__m128i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(pixels + i));
+		const __m128i gray = _mm_srli_epi32(_mm_mulhi_epu16(pixelSumsRGBASSE2(v), div3), 1);
+		const __m128i rgb = _mm_or_si128(gray, _mm_or_si128(_mm_slli_epi32(gray, 8), _mm_slli_epi32(gray, 16)));
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_or_si128(rgb, _mm_and_si128(v, alpha)));
+	}
+	grayscaleRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("sse2") static void thresholdRGBASSE2(ColorRGBA* pixels, unsigned int count)
+{
+	const __m128i limit = _mm_set1_epi32(381);
+	const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	const unsigned int step = sizeof(__m128i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(pixels + i));
+		const __m128i value = _mm_and_si128(_mm_cmpgt_epi32(pixelSumsRGBASSE2(v), limit), rgb);
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_or_si128(value, _mm_and_si128(v, alpha)));
+	}
+	thresholdRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("sse2") static void invertRGBASSE2(ColorRGBA* pixels, unsigned int count)
+{
+	const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+	const unsigned int step = sizeof(__m128i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(pixels + i));
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_xor_si128(v, rgb));
+	}
+	invertRGBAScalar(pixels + i, count - i);
+}
+
+// Resampling: the channels of a pixel in one vector, the weight broadcast to all of them
+
+SIMD_TARGET("sse2") static inline __m128 pixelToFloatsSSE2(unsigned int bits)
+{
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)bits), zero), zero));
+}
+
+SIMD_TARGET("sse2") static void resampleRowSSE2(const Color* in, float* out, unsigned int width, const int* first, const int* count, const float* weights, unsigned int taps)
+{
+	for (unsigned int x = 0; x < width; ++x) {
+		const unsigned char* pixels = (const unsigned char*)(in + first[x]);
+		const float* w = weights + x * taps;
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < count[x]; ++k) {
+			const unsigned char* p = pixels + 3 * k; //3 bytes, the 4th may be past the row
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), pixelToFloatsSSE2(p[0] | (p[1] << 8) | (p[2] << 16))));
+		}
+		if (x + 1 < width)
+			_mm_storeu_ps(out + x * 3, sum); //the 4th float is written again by the next pixel
+		else {
+			float last[4];
+			_mm_storeu_ps(last, sum);
+			memcpy(out + x * 3, last, 3 * sizeof(float));
+		}
+	}
+}
+
+SIMD_TARGET("sse2") static void resampleRowRGBASSE2(const ColorRGBA* in, float* out, unsigned int width, const int* first, const int* count, const float* weights, unsigned int taps)
+{
+	for (unsigned int x = 0; x < width; ++x) {
+		const ColorRGBA* pixels = in + first[x];
+		const float* w = weights + x * taps;
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < count[x]; ++k) {
+			unsigned int bits;
+			memcpy(&bits, pixels + k, 4);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), pixelToFloatsSSE2(bits)));
+		}
+		_mm_storeu_ps(out + x * 4, sum);
+	}
+}
+
+// AVX2: 32 pixels per block (unpack and pack work per 128 bit lane, so the order is preserved)
+
+SIMD_TARGET("avx2") static inline void pixelSumsAVX2(const unsigned char* p, int k, __m256i& lo, __m256i& hi)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const int m = k * 32;
+	const __m256i v0 = _mm256_loadu_si256((const __m256i*)p);
+	const __m256i n1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(p + 1)), _mm256_loadu_si256((const __m256i*)(phase_masks.next1 + m)));
+	const __m256i n2 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(p + 2)), _mm256_loadu_si256((const __m256i*)(phase_masks.next2 + m)));
+	const __m256i p1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(p - 1)), _mm256_loadu_si256((const __m256i*)(phase_masks.prev1 + m)));
+	const __m256i p2 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(p - 2)), _mm256_loadu_si256((const __m256i*)(phase_masks.prev2 + m)));
+
+	lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(v0, zero), _mm256_unpacklo_epi8(n1, zero)),
+		_mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(n2, zero), _mm256_unpacklo_epi8(p1, zero)), _mm256_unpacklo_epi8(p2, zero)));
+	hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(v0, zero), _mm256_unpackhi_epi8(n1, zero)),
+		_mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(n2, zero), _mm256_unpackhi_epi8(p1, zero)), _mm256_unpackhi_epi8(p2, zero)));
+}
+
+SIMD_TARGET("avx2") static void grayscaleAVX2(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m256i div3 = _mm256_set1_epi16((short)0xAAAB);
+
+	unsigned int pos = 3;
+	for (; pos + 96 + 2 <= total; pos += 96) {
+		__m256i lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+			pixelSumsAVX2(data + pos + k * 32, k, lo[k], hi[k]);
+		for (int k = 0; k < 3; ++k) {
+			const __m256i gray_lo = _mm256_srli_epi16(_mm256_mulhi_epu16(lo[k], div3), 1);
+			const __m256i gray_hi = _mm256_srli_epi16(_mm256_mulhi_epu16(hi[k], div3), 1);
+			_mm256_storeu_si256((__m256i*)(data + pos + k * 32), _mm256_packus_epi16(gray_lo, gray_hi));
+		}
+	}
+
+	if (count > 0)
+		grayscaleScalar(pixels, 1);
+	if (pos / 3 < count)
+		grayscaleSSE2(pixels + pos / 3, count - pos / 3);
+}
+
+SIMD_TARGET("avx2") static void thresholdAVX2(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m256i limit = _mm256_set1_epi16(381);
+
+	unsigned int pos = 3;
+	for (; pos + 96 + 2 <= total; pos += 96) {
+		__m256i lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+			pixelSumsAVX2(data + pos + k * 32, k, lo[k], hi[k]);
+		for (int k = 0; k < 3; ++k) {
+			const __m256i value_lo = _mm256_srli_epi16(_mm256_cmpgt_epi16(lo[k], limit), 8);
+			const __m256i value_hi = _mm256_srli_epi16(_mm256_cmpgt_epi16(hi[k], limit), 8);
+			_mm256_storeu_si256((__m256i*)(data + pos + k * 32), _mm256_packus_epi16(value_lo, value_hi));
+		}
+	}
+
+	if (count > 0)
+		thresholdScalar(pixels, 1);
+	if (pos / 3 < count)
+		thresholdSSE2(pixels + pos / 3, count - pos / 3);
+}
+
+SIMD_TARGET("avx2") static void invertAVX2(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m256i ones = _mm256_set1_epi8((char)0xFF);
+
+	unsigned int pos = 0;
+	for (; pos + 32 <= total; pos += 32)
+		_mm256_storeu_si256((__m256i*)(data + pos), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + pos)), ones));
+	for (; pos < total; ++pos)
+		data[pos] = 255 - data[pos];
+}
+
+SIMD_TARGET("avx2") static inline __m256i pixelSumsRGBAAVX2(__m256i v)
+{
+	const __m256i byte = _mm256_set1_epi32(0xFF);
+	return _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(v, byte), _mm256_and_si256(_mm256_srli_epi32(v, 8), byte)), _mm256_and_si256(_mm256_srli_epi32(v, 16), byte));
+}
+
+SIMD_TARGET("avx2") static void grayscaleRGBAAVX2(ColorRGBA* pixels, unsigned int count)
+{
+	const __m256i div3 = _mm256_set1_epi32(0xAAAB); //the high word of every lane is 0 on both sides
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	const unsigned int step = sizeof(__m256i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(pixels + i));
+		const __m256i gray = _mm256_srli_epi32(_mm256_mulhi_epu16(pixelSumsRGBAAVX2(v), div3), 1);
+		const __m256i rgb = _mm256_or_si256(gray, _mm256_or_si256(_mm256_slli_epi32(gray, 8), _mm256_slli_epi32(gray, 16)));
+		_mm256_storeu_si256((__m256i*)(pixels + i), _mm256_or_si256(rgb, _mm256_and_si256(v, alpha)));
+	}
+	grayscaleRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("avx2") static void thresholdRGBAAVX2(ColorRGBA* pixels, unsigned int count)
+{
+	const __m256i limit = _mm256_set1_epi32(381);
+	const __m256i rgb = _mm256_set1_epi32(0x00FFFFFF);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	const unsigned int step = sizeof(__m256i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(pixels + i));
+		const __m256i value = _mm256_and_si256(_mm256_cmpgt_epi32(pixelSumsRGBAAVX2(v), limit), rgb);
+		_mm256_storeu_si256((__m256i*)(pixels + i), _mm256_or_si256(value, _mm256_and_si256(v, alpha)));
+	}
+	thresholdRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("avx2") static void invertRGBAAVX2(ColorRGBA* pixels, unsigned int count)
+{
+	const __m256i rgb = _mm256_set1_epi32(0x00FFFFFF);
+	const unsigned int step = sizeof(__m256i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(pixels + i));
+		_mm256_storeu_si256((__m256i*)(pixels + i), _mm256_xor_si256(v, rgb));
+	}
+	invertRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("avx2") static void lookupRGBAAVX2(ColorRGBA* pixels, unsigned int count, const unsigned int (*tables)[256], const unsigned char* source)
+{
+	const __m256i byte = _mm256_set1_epi32(0xFF);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	const __m128i shift_r = _mm_cvtsi32_si128(source[0] * 8);
+	const __m128i shift_g = _mm_cvtsi32_si128(source[1] * 8);
+	const __m128i shift_b = _mm_cvtsi32_si128(source[2] * 8);
+
+	//8 gathers of 32 bit table entries per channel
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(pixels + i));
+		const __m256i r = _mm256_i32gather_epi32((const int*)tables[0], _mm256_and_si256(_mm256_srl_epi32(v, shift_r), byte), 4);
+		const __m256i g = _mm256_i32gather_epi32((const int*)tables[1], _mm256_and_si256(_mm256_srl_epi32(v, shift_g), byte), 4);
+		const __m256i b = _mm256_i32gather_epi32((const int*)tables[2], _mm256_and_si256(_mm256_srl_epi32(v, shift_b), byte), 4);
+		_mm256_storeu_si256((__m256i*)(pixels + i), _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, _mm256_and_si256(v, alpha))));
+	}
+	lookupRGBAScalar(pixels + i, count - i, tables, source);
+}
+
+// AVX-512 (needs the BW extension for byte and word operations): 64 pixels per block
+
+SIMD_TARGET("avx512f,avx512bw") static inline void pixelSumsAVX512(const unsigned char* p, int k, __m512i& lo, __m512i& hi)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const int m = k * 64;
+	const __m512i v0 = _mm512_loadu_si512((const void*)p);
+	const __m512i n1 = _mm512_and_si512(_mm512_loadu_si512((const void*)(p + 1)), _mm512_loadu_si512((const void*)(phase_masks.next1 + m)));
+	const __m512i n2 = _mm512_and_si512(_mm512_loadu_si512((const void*)(p + 2)), _mm512_loadu_si512((const void*)(phase_masks.next2 + m)));
+	const __m512i p1 = _mm512_and_si512(_mm512_loadu_si512((const void*)(p - 1)), _mm512_loadu_si512((const void*)(phase_masks.prev1 + m)));
+	const __m512i p2 = _mm512_and_si512(_mm512_loadu_si512((const void*)(p - 2)), _mm512_loadu_si512((const void*)(phase_masks.prev2 + m)));
+
+	lo = _mm512_add_epi16(_mm512_add_epi16(_mm512_unpacklo_epi8(v0, zero), _mm512_unpacklo_epi8(n1, zero)),
+		_mm512_add_epi16(_mm512_add_epi16(_mm512_unpacklo_epi8(n2, zero), _mm512_unpacklo_epi8(p1, zero)), _mm512_unpacklo_epi8(p2, zero)));
+	hi = _mm512_add_epi16(_mm512_add_epi16(_mm512_unpackhi_epi8(v0, zero), _mm512_unpackhi_epi8(n1, zero)),
+		_mm512_add_epi16(_mm512_add_epi16(_mm512_unpackhi_epi8(n2, zero), _mm512_unpackhi_epi8(p1, zero)), _mm512_unpackhi_epi8(p2, zero)));
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void grayscaleAVX512(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m512i div3 = _mm512_set1_epi16((short)0xAAAB);
+
+	unsigned int pos = 3;
+	for (; pos + 192 + 2 <= total; pos += 192) {
+		__m512i lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+			pixelSumsAVX512(data + pos + k * 64, k, lo[k], hi[k]);
+		for (int k = 0; k < 3; ++k) {
+			const __m512i gray_lo = _mm512_srli_epi16(_mm512_mulhi_epu16(lo[k], div3), 1);
+			const __m512i gray_hi = _mm512_srli_epi16(_mm512_mulhi_epu16(hi[k], div3), 1);
+			_mm512_storeu_si512((void*)(data + pos + k * 64), _mm512_packus_epi16(gray_lo, gray_hi));
+		}
+	}
+
+	if (count > 0)
+		grayscaleScalar(pixels, 1);
+	if (pos / 3 < count)
+		grayscaleAVX2(pixels + pos / 3, count - pos / 3);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void thresholdAVX512(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m512i limit = _mm512_set1_epi16(381);
+	const __m512i white = _mm512_set1_epi16(255);
+
+	unsigned int pos = 3;
+	for (; pos + 192 + 2 <= total; pos += 192) {
+		__m512i lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+			pixelSumsAVX512(data + pos + k * 64, k, lo[k], hi[k]);
+		for (int k = 0; k < 3; ++k) {
+			//AVX-512 compares return a bit mask instead of a vector
+			const __m512i value_lo = _mm512_maskz_mov_epi16(_mm512_cmpgt_epi16_mask(lo[k], limit), white);
+			const __m512i value_hi = _mm512_maskz_mov_epi16(_mm512_cmpgt_epi16_mask(hi[k], limit), white);
+			_mm512_storeu_si512((void*)(data + pos + k * 64), _mm512_packus_epi16(value_lo, value_hi));
+		}
+	}
+
+	if (count > 0)
+		thresholdScalar(pixels, 1);
+	if (pos / 3 < count)
+		thresholdAVX2(pixels + pos / 3, count - pos / 3);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void invertAVX512(Color* pixels, unsigned int count)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	const unsigned int total = count * 3;
+	const __m512i ones = _mm512_set1_epi8((char)0xFF);
+
+	unsigned int pos = 0;
+	for (; pos + 64 <= total; pos += 64)
+		_mm512_storeu_si512((void*)(data + pos), _mm512_xor_si512(_mm512_loadu_si512((const void*)(data + pos)), ones));
+	for (; pos < total; ++pos)
+		data[pos] = 255 - data[pos];
+}
+
+SIMD_TARGET("avx512f,avx512bw") static inline __m512i pixelSumsRGBAAVX512(__m512i v)
+{
+	const __m512i byte = _mm512_set1_epi32(0xFF);
+	return _mm512_add_epi32(_mm512_add_epi32(_mm512_and_si512(v, byte), _mm512_and_si512(_mm512_srli_epi32(v, 8), byte)), _mm512_and_si512(_mm512_srli_epi32(v, 16), byte));
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void grayscaleRGBAAVX512(ColorRGBA* pixels, unsigned int count)
+{
+	const __m512i div3 = _mm512_set1_epi32(0xAAAB); //the high word of every lane is 0 on both sides
+	const __m512i alpha = _mm512_set1_epi32((int)0xFF000000);
+	const unsigned int step = sizeof(__m512i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m512i v = _mm512_loadu_si512((const void*)(pixels + i));
+		const __m512i gray = _mm512_srli_epi32(_mm512_mulhi_epu16(pixelSumsRGBAAVX512(v), div3), 1);
+		const __m512i rgb = _mm512_or_si512(gray, _mm512_or_si512(_mm512_slli_epi32(gray, 8), _mm512_slli_epi32(gray, 16)));
+		_mm512_storeu_si512((void*)(pixels + i), _mm512_or_si512(rgb, _mm512_and_si512(v, alpha)));
+	}
+	grayscaleRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void thresholdRGBAAVX512(ColorRGBA* pixels, unsigned int count)
+{
+	const __m512i limit = _mm512_set1_epi32(381);
+	const __m512i rgb = _mm512_set1_epi32(0x00FFFFFF);
+	const __m512i alpha = _mm512_set1_epi32((int)0xFF000000);
+	const unsigned int step = sizeof(__m512i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m512i v = _mm512_loadu_si512((const void*)(pixels + i));
+		const __m512i value = _mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(pixelSumsRGBAAVX512(v), limit), rgb);
+		_mm512_storeu_si512((void*)(pixels + i), _mm512_or_si512(value, _mm512_and_si512(v, alpha)));
+	}
+	thresholdRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void invertRGBAAVX512(ColorRGBA* pixels, unsigned int count)
+{
+	const __m512i rgb = _mm512_set1_epi32(0x00FFFFFF);
+	const unsigned int step = sizeof(__m512i) / 4;
+
+	unsigned int i = 0;
+	for (; i + step <= count; i += step) {
+		const __m512i v = _mm512_loadu_si512((const void*)(pixels + i));
+		_mm512_storeu_si512((void*)(pixels + i), _mm512_xor_si512(v, rgb));
+	}
+	invertRGBAScalar(pixels + i, count - i);
+}
+
+SIMD_TARGET("avx512f,avx512bw") static void lookupRGBAAVX512(ColorRGBA* pixels, unsigned int count, const unsigned int (*tables)[256], const unsigned char* source)
+{
+	const __m512i byte = _mm512_set1_epi32(0xFF);
+	const __m512i alpha = _mm512_set1_epi32((int)0xFF000000);
+	const __m128i shift_r = _mm_cvtsi32_si128(source[0] * 8);
+	const __m128i shift_g = _mm_cvtsi32_si128(source[1] * 8);
+	const __m128i shift_b = _mm_cvtsi32_si128(source[2] * 8);
+
+	unsigned int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		const __m512i v = _mm512_loadu_si512((const void*)(pixels + i));
+		const __m512i r = _mm512_i32gather_epi32(_mm512_and_si512(_mm512_srl_epi32(v, shift_r), byte), (const void*)tables[0], 4);
+		const __m512i g = _mm512_i32gather_epi32(_mm512_and_si512(_mm512_srl_epi32(v, shift_g), byte), (const void*)tables[1], 4);
+		const __m512i b = _mm512_i32gather_epi32(_mm512_and_si512(_mm512_srl_epi32(v, shift_b), byte), (const void*)tables[2], 4);
+		_mm512_storeu_si512((void*)(pixels + i), _mm512_or_si512(_mm512_or_si512(r, g), _mm512_or_si512(b, _mm512_and_si512(v, alpha))));
+	}
+	lookupRGBAAVX2(pixels + i, count - i, tables, source);
+}
+
+#endif
+
+static const PixelKernels kernel_table[SIMD_NUM_LEVELS] =
+{
+	{ SIMD_SCALAR, "scalar", grayscaleScalar, thresholdScalar, invertScalar, grayscaleRGBAScalar, thresholdRGBAScalar, invertRGBAScalar, lookupRGBAScalar, resampleRowScalar<Color>, resampleRowScalar<ColorRGBA> },
+#ifdef SIMD_X86
+	{ SIMD_SSE2, "SSE2", grayscaleSSE2, thresholdSSE2, invertSSE2, grayscaleRGBASSE2, thresholdRGBASSE2, invertRGBASSE2, lookupRGBAScalar, resampleRowSSE2, resampleRowRGBASSE2 },
+	{ SIMD_AVX2, "AVX2", grayscaleAVX2, thresholdAVX2, invertAVX2, grayscaleRGBAAVX2, thresholdRGBAAVX2, invertRGBAAVX2, lookupRGBAAVX2, resampleRowSSE2, resampleRowRGBASSE2 },
+	{ SIMD_AVX512, "AVX-512", grayscaleAVX512, thresholdAVX512, invertAVX512, grayscaleRGBAAVX512, thresholdRGBAAVX512, invertRGBAAVX512, lookupRGBAAVX512, resampleRowSSE2, resampleRowRGBASSE2 },
+#endif
+};
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+//cpuid bits, the OS must also save the wide registers (xgetbv) for AVX to be usable
+static SIMDLevel detectSIMDLevel()
+{
+	int info[4];
+	__cpuid(info, 0);
+	const int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	if (!(info[3] & (1 << 26))) return SIMD_SCALAR; //SSE2
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || max_leaf < 7) return SIMD_SSE2;
+
+	const unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6) return SIMD_SSE2; //XMM and YMM state
+
+	__cpuidex(info, 7, 0);
+	if (!(info[1] & (1 << 5))) return SIMD_SSE2; //AVX2
+	const bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)); //AVX512F and AVX512BW
+	if (!avx512 || (xcr0 & 0xE6) != 0xE6) return SIMD_AVX2; //opmask and ZMM state
+	return SIMD_AVX512;
+}
+#elif defined(SIMD_X86)
+static SIMDLevel detectSIMDLevel()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+	return SIMD_SCALAR;
+}
+#else
+static SIMDLevel detectSIMDLevel() { return SIMD_SCALAR; }
+#endif
+
+SIMDLevel getSupportedSIMDLevel()
+{
+	static const SIMDLevel level = detectSIMDLevel();
+	return level;
+}
+
+const PixelKernels& getPixelKernels()
+{
+	static const PixelKernels& kernels = getPixelKernels(getSupportedSIMDLevel());
+	return kernels;
+}
+
+const PixelKernels& getPixelKernels(SIMDLevel level)
+{
+	const SIMDLevel supported = getSupportedSIMDLevel();
+	if (level > supported) level = supported;
+	if (level < SIMD_SCALAR) level = SIMD_SCALAR;
+	return kernel_table[level];
+}
+
+// Self test
+
+static unsigned int test_seed = 12345;
+static unsigned char randomTestByte()
+{
+	test_seed = test_seed * 1103515245 + 12345;
+	return (unsigned char)(test_seed >> 16);
+}
+
+//runs kernel and reference on the same random pixels, count of them from offset, and compares the whole buffers
+//(so the pixels around the span must not be touched either)
+template <typename PixelT, typename F, typename G>
+static bool compareKernel(const char* level, const char* name, unsigned int offset, unsigned int count, F kernel, G reference)
+{
+	std::vector<PixelT> result(offset + count + 8);
+	unsigned char* bytes = (unsigned char*)&result[0];
+	for (size_t i = 0; i < result.size() * sizeof(PixelT); ++i)
+		bytes[i] = randomTestByte();
+	std::vector<PixelT> expected = result;
+
+	kernel(&result[offset], count);
+	reference(&expected[offset], count);
+	if (memcmp(&result[0], &expected[0], result.size() * sizeof(PixelT)) == 0)
+		return true;
+	printf("%s %s differs from the scalar one (%u pixels from %u)\n", level, name, count, offset);
+	return false;
+}
+
+//horizontal resampling of a row of width pixels with random weights, first inputs and counts
+template <typename PixelT, typename F>
+static bool compareResample(const char* level, const char* name, unsigned int width, F kernel, F reference)
+{
+	const unsigned int taps = 1 + randomTestByte() % 8, channels = sizeof(PixelT);
+	std::vector<PixelT> in(width + taps);
+	unsigned char* bytes = (unsigned char*)&in[0];
+	for (size_t i = 0; i < in.size() * sizeof(PixelT); ++i)
+		bytes[i] = randomTestByte();
+	std::vector<int> first(width), count(width);
+	std::vector<float> weights(width * taps);
+	for (unsigned int x = 0; x < width; ++x) {
+		first[x] = randomTestByte() % (width + 1);
+		count[x] = randomTestByte() % (taps + 1);
+	}
+	for (size_t i = 0; i < weights.size(); ++i)
+		weights[i] = randomTestByte() / 128.0f - 0.5f;
+
+	std::vector<float> result(width * channels + 4, -1.0f);
+	std::vector<float> expected = result;
+	kernel(&in[0], &result[0], width, first.data(), count.data(), weights.data(), taps);
+	reference(&in[0], &expected[0], width, first.data(), count.data(), weights.data(), taps);
+	if (memcmp(&result[0], &expected[0], result.size() * sizeof(float)) == 0)
+		return true;
+	printf("%s %s differs from the scalar one (%u pixels)\n", level, name, width);
+	return false;
+}
+
+bool testPixelKernels()
+{
+	const PixelKernels& scalar = getPixelKernels(SIMD_SCALAR);
+
+	//random tables for the lookup, one output channel reads the same input as another
+	static unsigned int tables[3][256];
+	for (int c = 0; c < 3; ++c)
+		for (int v = 0; v < 256; ++v)
+			tables[c][v] = (unsigned int)randomTestByte() << (8 * c);
+	const unsigned char source[3] = { 2, 0, 2 };
+
+	//every length around the vector widths, and one much larger than them
+	std::vector<unsigned int> counts;
+	for (unsigned int count = 0; count <= 67; ++count)
+		counts.push_back(count);
+	counts.push_back(100003);
+	const unsigned int offsets[] = { 0, 1, 3 };
+
+	bool ok = true;
+	for (int level = SIMD_SSE2; level <= getSupportedSIMDLevel(); ++level) {
+		const PixelKernels& k = getPixelKernels((SIMDLevel)level);
+		for (size_t i = 0; i < counts.size(); ++i)
+			for (unsigned int j = 0; j < 3; ++j) {
+				const unsigned int count = counts[i], offset = offsets[j];
+				ok = compareKernel<Color>(k.name, "grayscale", offset, count, k.grayscale, scalar.grayscale) && ok;
+				ok = compareKernel<Color>(k.name, "threshold", offset, count, k.threshold, scalar.threshold) && ok;
+				ok = compareKernel<Color>(k.name, "invert", offset, count, k.invert, scalar.invert) && ok;
+				ok = compareKernel<ColorRGBA>(k.name, "grayscaleRGBA", offset, count, k.grayscaleRGBA, scalar.grayscaleRGBA) && ok;
+				ok = compareKernel<ColorRGBA>(k.name, "thresholdRGBA", offset, count, k.thresholdRGBA, scalar.thresholdRGBA) && ok;
+				ok = compareKernel<ColorRGBA>(k.name, "invertRGBA", offset, count, k.invertRGBA, scalar.invertRGBA) && ok;
+				ok = compareKernel<ColorRGBA>(k.name, "lookupRGBA", offset, count,
+					[&](ColorRGBA* pixels, unsigned int n) { k.lookupRGBA(pixels, n, tables, source); },
+					[&](ColorRGBA* pixels, unsigned int n) { scalar.lookupRGBA(pixels, n, tables, source); }) && ok;
+			}
+		for (size_t i = 0; i < counts.size(); ++i) {
+			ok = compareResample<Color>(k.name, "resampleRow", counts[i], k.resampleRow, scalar.resampleRow) && ok;
+			ok = compareResample<ColorRGBA>(k.name, "resampleRowRGBA", counts[i], k.resampleRowRGBA, scalar.resampleRowRGBA) && ok;
+		}
+		printf("pixel kernels: %s compared with scalar\n", k.name);
+	}
+	printf("pixel kernels: %s\n", ok ? "all identical" : "DIFFERENT");
+	return ok;
+}
@@ -0,0 +1,57 @@
+/*  simd.h
+	Vectorized versions of the point filters of Image (grayscale, threshold and invert), for the
+	packed 3 byte Color and for the 4 byte ColorRGBA (which keeps its alpha), plus the table lookup
+	of ColorRGBA used by ChannelLUT (gathers from AVX2 on, SSE2 has none so it uses the scalar one), and
+	the horizontal pass of the resampler for both formats (one pixel per SSE2 vector at every level).
+	The point kernels work in place over a contiguous span of pixels. The scalar kernels are the
+	reference implementation: the SSE2, AVX2 and AVX-512 ones must produce exactly the same bytes.
+	The best instruction set supported by the CPU is chosen once, the first time the table is requested.
+*/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "framework.h"
+
+//instruction sets with kernels, from slowest to fastest
+enum SIMDLevel
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512,
+	SIMD_NUM_LEVELS
+};
+
+//dispatch table, every kernel processes 'count' consecutive pixels starting at 'pixels'
+struct PixelKernels
+{
+	SIMDLevel level;
+	const char* name;
+	void (*grayscale)(Color* pixels, unsigned int count);
+	void (*threshold)(Color* pixels, unsigned int count);
+	void (*invert)(Color* pixels, unsigned int count);
+	void (*grayscaleRGBA)(ColorRGBA* pixels, unsigned int count);
+	void (*thresholdRGBA)(ColorRGBA* pixels, unsigned int count);
+	void (*invertRGBA)(ColorRGBA* pixels, unsigned int count);
+	void (*lookupRGBA)(ColorRGBA* pixels, unsigned int count, const unsigned int (*tables)[256], const unsigned char* source); //see lut.h
+
+	//out[x] (3 or 4 floats) = sum of weights[x * taps + k] * in[first[x] + k] for k < count[x], for x < width (see resample.h)
+	void (*resampleRow)(const Color* in, float* out, unsigned int width, const int* first, const int* count, const float* weights, unsigned int taps);
+	void (*resampleRowRGBA)(const ColorRGBA* in, float* out, unsigned int width, const int* first, const int* count, const float* weights, unsigned int taps);
+};
+
+//best instruction set supported by this CPU (and compiled in)
+SIMDLevel getSupportedSIMDLevel();
+
+//kernels for the best supported instruction set
+const PixelKernels& getPixelKernels();
+
+//kernels for a specific instruction set, clamped to the supported one (useful to compare paths)
+const PixelKernels& getPixelKernels(SIMDLevel level);
+
+//runs every kernel of every supported instruction set on random spans (all the lengths up to 67, odd offsets and a
+//large one) and compares the bytes with the scalar ones, prints the differences and returns false if there is any
+bool testPixelKernels();
+
+#endif
@@ -0,0 +1,151 @@
+#include "threadpool.h"
+
+//true while the current thread is executing tasks of a job, so nested parallel loops run serially
+static thread_local bool inside_task = false;
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+{
+	task = NULL;
+	task_count = 0;
+	next_task = 0;
+	finished_tasks = 0;
+	active_workers = 0;
+	generation = 0;
+	stopping = false;
+
+	if (num_threads == 0)
+		num_threads = std::thread::hardware_concurrency();
+	startWorkers(num_threads > 1 ? num_threads - 1 : 0);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+}
+
+void ThreadPool::setNumThreads(unsigned int num_threads)
+{
+	if (num_threads == 0)
+		num_threads = std::thread::hardware_concurrency();
+	if (num_threads == 0)
+		num_threads = 1;
+	if (num_threads == getNumThreads())
+		return;
+
+	//wait until no job is running
+	std::lock_guard<std::mutex> run_lock(run_mutex);
+	stopWorkers();
+	startWorkers(num_threads - 1);
+}
+
+void ThreadPool::startWorkers(unsigned int num_workers)
+{
+	stopping = false;
+	for (unsigned int i = 0; i < num_workers; ++i)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+void ThreadPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake_condition.notify_all();
+	for (unsigned int i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	workers.clear();
+}
+
+void ThreadPool::run(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+	if (count == 0)
+		return;
+
+	//serial path: no workers, a single task, a nested loop or another thread already using the pool
+	if (workers.empty() || count == 1 || inside_task || !run_mutex.try_lock()) {
+		for (unsigned int i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+	std::lock_guard<std::mutex> run_lock(run_mutex, std::adopt_lock);
+
+	//publish the job and wake the workers
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &fn;
+		task_count = count;
+		next_task = 0;
+		finished_tasks = 0;
+		++generation;
+	}
+	wake_condition.notify_all();
+
+	//work on it too
+	const unsigned int done = runTasks(task, count);
+
+	//wait for the tasks taken by the workers (and for the workers to leave the job)
+	std::unique_lock<std::mutex> lock(mutex);
+	finished_tasks += done;
+	done_condition.wait(lock, [this]() { return finished_tasks == task_count && active_workers == 0; });
+	task = NULL;
+}
+
+unsigned int ThreadPool::runTasks(const std::function<void(unsigned int)>* job, unsigned int count)
+{
+	unsigned int done = 0;
+	inside_task = true;
+	for (;;) {
+		const unsigned int i = next_task++;
+		if (i >= count)
+			break;
+		(*job)(i);
+		++done;
+	}
+	inside_task = false;
+	return done;
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned int seen_generation = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake_condition.wait(lock, [&]() { return stopping || generation != seen_generation; });
+		if (stopping)
+			return;
+		seen_generation = generation;
+		if (task == NULL)
+			continue; //woke up after the job was already finished
+
+		//take a snapshot of the job while holding the lock
+		const std::function<void(unsigned int)>* job = task;
+		const unsigned int count = task_count;
+		++active_workers;
+		lock.unlock();
+
+		const unsigned int done = runTasks(job, count);
+
+		lock.lock();
+		finished_tasks += done;
+		--active_workers;
+		if (finished_tasks == task_count && active_workers == 0)
+			done_condition.notify_one();
+	}
+}
+
+ThreadPool& ThreadPool::getInstance()
+{
+	static ThreadPool pool(0);
+	return pool;
+}
+
+void setThreadCount(unsigned int num_threads)
+{
+	ThreadPool::getInstance().setNumThreads(num_threads);
+}
+
+unsigned int getThreadCount()
+{
+	return ThreadPool::getInstance().getNumThreads();
+}
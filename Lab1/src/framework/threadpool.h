@@ -0,0 +1,105 @@
+/*  threadpool.h
+	Persistent pool of worker threads used by Image to split per-pixel work by rows or by tiles.
+	The workers are created once and sleep between jobs. The calling thread also takes tasks.
+	With 1 thread (or when called from inside another parallel task) everything runs serially
+	on the calling thread, exactly like the original loops.
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int num_threads);
+	~ThreadPool();
+
+	// Number of threads working on a job, the calling one included
+	unsigned int getNumThreads() const { return (unsigned int)workers.size() + 1; }
+
+	// Changes the number of threads (0 uses all the hardware threads, 1 is serial)
+	void setNumThreads(unsigned int num_threads);
+
+	// Calls task(i) for every i in [0, count) and returns when all of them are done
+	void run(unsigned int count, const std::function<void(unsigned int)>& task);
+
+	// Pool shared by the whole framework
+	static ThreadPool& getInstance();
+
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex run_mutex; //only one job at a time
+	std::mutex mutex;
+	std::condition_variable wake_condition;
+	std::condition_variable done_condition;
+
+	//current job
+	const std::function<void(unsigned int)>* task;
+	unsigned int task_count;
+	std::atomic<unsigned int> next_task;
+	unsigned int finished_tasks;
+	unsigned int active_workers;
+	unsigned int generation;
+	bool stopping;
+
+	void startWorkers(unsigned int num_workers);
+	void stopWorkers();
+	void workerLoop();
+	unsigned int runTasks(const std::function<void(unsigned int)>* job, unsigned int count);
+};
+
+// Thread count knob for the shared pool (1 means the original serial behaviour)
+void setThreadCount(unsigned int num_threads);
+unsigned int getThreadCount();
+
+// Splits the rows [0, height) in bands and calls fn(y_begin, y_end) for every band in parallel
+template <typename F>
+void parallelForRows(unsigned int height, F fn)
+{
+	ThreadPool& pool = ThreadPool::getInstance();
+	const unsigned int num_threads = pool.getNumThreads();
+	if (num_threads == 1 || height < 2) {
+		if (height) fn(0u, height);
+		return;
+	}
+
+	//a few bands per thread so an uneven band does not stall the others
+	unsigned int band = height / (num_threads * 4);
+	if (band < 1) band = 1;
+	const unsigned int num_bands = (height + band - 1) / band;
+
+	pool.run(num_bands, [&](unsigned int i) {
+		const unsigned int y_begin = i * band;
+		const unsigned int y_end = y_begin + band < height ? y_begin + band : height;
+		fn(y_begin, y_end);
+	});
+}
+
+// Splits the area [0, width) x [0, height) in square tiles and calls fn(x_begin, y_begin, x_end, y_end) for every tile in parallel
+template <typename F>
+void parallelForTiles(unsigned int width, unsigned int height, unsigned int tile_size, F fn)
+{
+	if (width == 0 || height == 0) return;
+	if (tile_size == 0) tile_size = 64;
+
+	const unsigned int tiles_x = (width + tile_size - 1) / tile_size;
+	const unsigned int tiles_y = (height + tile_size - 1) / tile_size;
+
+	ThreadPool::getInstance().run(tiles_x * tiles_y, [&](unsigned int i) {
+		const unsigned int x_begin = (i % tiles_x) * tile_size;
+		const unsigned int y_begin = (i / tiles_x) * tile_size;
+		const unsigned int x_end = x_begin + tile_size < width ? x_begin + tile_size : width;
+		const unsigned int y_end = y_begin + tile_size < height ? y_begin + tile_size : height;
+		fn(x_begin, y_begin, x_end, y_end);
+	});
+}
+
+#endif
@@ -21,6 +21,7 @@
 #include "includes.h"
 #include "application.h"
 #include "image.h"
+#include "renderthread.h"
 
 std::string getBinPath()
 {
@@ -114,18 +115,75 @@ SDL_Window* createWindow(const char* caption, int width, int height )
 	return window;
 }
 
+//Applies the events waiting in the queue and reads the mouse, false when the app has to close
+static bool readEvents(Application* app)
+{
+	SDL_Event sdlEvent;
+
+	// Read events from the system
+	while(SDL_PollEvent(&sdlEvent))
+	{
+		switch(sdlEvent.type)
+			{
+				case SDL_QUIT: return false; break; //EVENT for when the user clicks the [x] in the corner
+				case SDL_MOUSEBUTTONDOWN: //EXAMPLE OF sync mouse input
+					app->mouse_state |= SDL_BUTTON(sdlEvent.button.button);
+					app->onMouseButtonDown(sdlEvent.button);
+					break;
+				case SDL_MOUSEBUTTONUP:
+					app->mouse_state &= ~SDL_BUTTON(sdlEvent.button.button);
+					app->onMouseButtonUp(sdlEvent.button);
+					break;
+				case SDL_KEYDOWN: //EXAMPLE OF sync keyboard input
+					app->onKeyDown(sdlEvent.key);
+					break;
+				case SDL_KEYUP: //EXAMPLE OF sync keyboard input
+					app->onKeyUp(sdlEvent.key);
+					break;
+				case SDL_TEXTINPUT:
+					// you can read the ASCII character from sdlEvent.text.text 
+					break;
+				case SDL_WINDOWEVENT:
+					switch (sdlEvent.window.event) {
+						case SDL_WINDOWEVENT_RESIZED: //resize opengl context
+							std::cout << "window resize" << std::endl;
+							app->setWindowSize( sdlEvent.window.data1, sdlEvent.window.data2 );
+							break;
+					}
+			}
+	}
+
+	// Get mouse position and delta
+	int x,y;
+	app->mouse_state = SDL_GetMouseState(&x,&y);
+	y = app->window_height - y; //reverse
+	app->mouse_delta.set( app->mouse_position.x - x, app->mouse_position.y - y );
+	app->mouse_position.set(x,y);
+
+	return true;
+}
+
+//Longest sleep of the main loop while the app is idle, in milliseconds
+static const int IDLE_TIMEOUT_MS = 250;
+
 //The application main loop
 void launchLoop(Application* app)
 {
 	SDL_Event sdlEvent;
-	double last_time = SDL_GetTicks();
+	FrameScheduler& scheduler = app->scheduler;
 	int x,y;
 
 	SDL_GetMouseState(&x,&y);
 	y = app->window_height - y;
 	app->mouse_position.set(x,y);
 
-	double start_time = SDL_GetTicks();
+	scheduler.reset();
+
+	//pipelined mode: the next frame is rendered into app->framebuffer on another thread while the last one is shown
+	RenderThread render_thread;
+	Image presented; //last frame rendered, swapped with the framebuffer (the pixels are never copied)
+	presented.setRowAlignment(Image::BUFFER_ALIGNMENT);
+	bool pending = false; //presented holds a frame not shown yet
 
 	//infinite loop
 	while (1)
@@ -137,72 +195,132 @@ void launchLoop(Application* app)
 		// Clear the window and the depth buffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Call render function
-		app->render( app->framebuffer );
-
-		// Send to GPU
-		sendFramebufferToScreen(&app->framebuffer);
-
-		// Swap between front buffer and back buffer to show it 
-		SDL_GL_SwapWindow(app->window);
-
-		// Read events from the system
-		while(SDL_PollEvent(&sdlEvent))
+		if (app->pipelined && app->redrawsWholeFrame())
 		{
-			switch(sdlEvent.type)
-				{
-					case SDL_QUIT: return; break; //EVENT for when the user clicks the [x] in the corner
-					case SDL_MOUSEBUTTONDOWN: //EXAMPLE OF sync mouse input
-						app->mouse_state |= SDL_BUTTON(sdlEvent.button.button);
-						app->onMouseButtonDown(sdlEvent.button);
-						break;
-					case SDL_MOUSEBUTTONUP:
-						app->mouse_state &= ~SDL_BUTTON(sdlEvent.button.button);
-						app->onMouseButtonUp(sdlEvent.button);
-						break;
-					case SDL_KEYDOWN: //EXAMPLE OF sync keyboard input
-						app->onKeyDown(sdlEvent.key);
-						break;
-					case SDL_KEYUP: //EXAMPLE OF sync keyboard input
-						app->onKeyUp(sdlEvent.key);
-						break;
-					case SDL_TEXTINPUT:
-						// you can read the ASCII character from sdlEvent.text.text 
-						break;
-					case SDL_WINDOWEVENT:
-						switch (sdlEvent.window.event) {
-							case SDL_WINDOWEVENT_RESIZED: //resize opengl context
-								std::cout << "window resize" << std::endl;
-								app->setWindowSize( sdlEvent.window.data1, sdlEvent.window.data2 );
-								break;
-						}
-				}
+			// Render the next frame while the last one is sent to the GPU and shown
+			render_thread.begin([app] { app->render( app->framebuffer ); });
+			if (pending)
+			{
+				sendFramebufferToScreen(&presented);
+				SDL_GL_SwapWindow(app->window);
+			}
+			render_thread.wait();
+
+			// The new frame is shown in the next iteration, the old buffer is the target of the next render
+			app->framebuffer.swap(presented);
+			if (app->framebuffer.width != presented.width || app->framebuffer.height != presented.height)
+				app->framebuffer.resize(presented.width, presented.height); //the window was resized
+			presented.markModified(); //the texture holds the other buffer, so all of it is sent
+			pending = true;
+		}
+		else
+		{
+			// Out of the pipeline the app keeps drawing on its last frame
+			if (pending)
+			{
+				app->framebuffer.swap(presented);
+				app->framebuffer.markModified();
+				pending = false;
+			}
+
+			// Call render function
+			app->render( app->framebuffer );
+
+			// Send to GPU
+			sendFramebufferToScreen(&app->framebuffer);
+
+			// Swap between front buffer and back buffer to show it 
+			SDL_GL_SwapWindow(app->window);
 		}
 
-		// Get mouse position and delta
-		app->mouse_state = SDL_GetMouseState(&x,&y);
-		y = app->window_height - y; //reverse
-		app->mouse_delta.set( app->mouse_position.x - x, app->mouse_position.y - y );
-		app->mouse_position.set(x,y);
+		// Read events from the system
+		if (!readEvents(app))
+			return;
 
-		// Update logic
-		double now = SDL_GetTicks();
-		double elapsed_time = (now - last_time) * 0.001; //0.001 converts from milliseconds to seconds
-		app->app_time = (now - start_time) * 0.001;
-		app->update(elapsed_time);
-		last_time = now;
+		// Update logic in fixed steps, as many as the time of the frame fits (render interpolates with the rest)
+		scheduler.beginFrame();
+		while (scheduler.step())
+		{
+			app->app_time = scheduler.getTime();
+			app->update(scheduler.getTimeStep());
+		}
 
 		// Check errors in opengl only when working in debug
 		#ifdef _DEBUG
 			checkGLErrors();
 		#endif
+
+		// Nothing moves: sleep until an event (or the timeout, so the window is still redrawn now and then)
+		if (app->wait_when_idle && !app->isAnimating())
+		{
+			if (SDL_WaitEventTimeout(&sdlEvent, IDLE_TIMEOUT_MS))
+			{
+				// Back in the queue (it was empty) and read now, so the next frame already shows its effect
+				SDL_PushEvent(&sdlEvent);
+				if (!readEvents(app))
+					return;
+			}
+			scheduler.reset(); //the time asleep does not move the next update
+		}
+		else
+			scheduler.endFrame(); //wait for the next frame at the target rate
 	}
 
 	return;
 }
 
+// Texture holding the last framebuffer sent, only the parts written since then are uploaded again
+static GLuint framebuffer_texture = 0;
+static unsigned int texture_width = 0, texture_height = 0;
+
 void sendFramebufferToScreen( Image* img )
 {
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1 );
-	glDrawPixels(img->width, img->height, GL_RGB, GL_UNSIGNED_BYTE, img->pixels);
+	if (img->width == 0 || img->height == 0)
+		return;
+
+	// Describe the row layout of the image so the padded rows (or a rectangle of them) are uploaded without repacking
+	const unsigned int pitch = img->getPitch();
+	const int alignment = pitch % 8 == 0 ? 8 : (pitch % 4 == 0 ? 4 : (pitch % 2 == 0 ? 2 : 1));
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment );
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, img->stride );
+	if (!framebuffer_texture)
+		glGenTextures(1, &framebuffer_texture);
+	glBindTexture(GL_TEXTURE_2D, framebuffer_texture);
+
+	if (img->width != texture_width || img->height != texture_height)
+	{
+		// New size, the whole image is sent
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, img->width, img->height, 0, GL_RGB, GL_UNSIGNED_BYTE, img->pixels.get());
+		texture_width = img->width;
+		texture_height = img->height;
+		img->takeDirtyRects();
+	}
+	else if (img->isDirty())
+	{
+		// Only the rectangles written since the last frame, nothing at all when the image did not change
+		const std::vector<DirtyRect> rects = img->takeDirtyRects();
+		for (size_t i = 0; i < rects.size(); ++i)
+		{
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, rects[i].x );
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, rects[i].y );
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rects[i].x, rects[i].y, rects[i].w, rects[i].h, GL_RGB, GL_UNSIGNED_BYTE, img->pixels.get());
+		}
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0 );
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0 );
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0 );
+
+	// The texture covers the viewport, its first row at the bottom like glDrawPixels
+	glEnable(GL_TEXTURE_2D);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0); glVertex2f(-1, -1);
+	glTexCoord2f(1, 0); glVertex2f(1, -1);
+	glTexCoord2f(1, 1); glVertex2f(1, 1);
+	glTexCoord2f(0, 1); glVertex2f(-1, 1);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
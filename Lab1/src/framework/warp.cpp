@@ -0,0 +1,171 @@
+#include "warp.h"
+
+AffineTransform AffineTransform::inverse() const
+{
+	const double inv = 1.0 / determinant();
+	const double a = m[4] * inv, b = -m[1] * inv;
+	const double c = -m[3] * inv, d = m[0] * inv;
+	return AffineTransform(a, b, -(a * m[2] + b * m[5]), c, d, -(c * m[2] + d * m[5]));
+}
+
+AffineTransform AffineTransform::operator * (const AffineTransform& o) const
+{
+	return AffineTransform(
+		m[0] * o.m[0] + m[1] * o.m[3], m[0] * o.m[1] + m[1] * o.m[4], m[0] * o.m[2] + m[1] * o.m[5] + m[2],
+		m[3] * o.m[0] + m[4] * o.m[3], m[3] * o.m[1] + m[4] * o.m[4], m[3] * o.m[2] + m[4] * o.m[5] + m[5]);
+}
+
+// 32.32 fixed point, the integer part of a position is the pixel (>> rounds down, also below 0)
+typedef long long Fixed;
+static const double FIXED_ONE = 4294967296.0;
+static inline int fixedFloor(Fixed value) { return (int)(value >> 32); }
+static inline unsigned int fixedFraction(Fixed value) { return (unsigned int)(value & 0xFFFFFFFF); }
+
+// Positions and steps are bounded so start + x * step can not overflow for any row of up to 65536 pixels
+static inline Fixed toFixed(double value, double limit) { return (Fixed)llround(std::min(std::max(value, -limit), limit) * FIXED_ONE); }
+
+// Narrows [begin,end) to the x where lo <= start + x * step < hi
+static void clipSpan(Fixed start, Fixed step, Fixed lo, Fixed hi, int& begin, int& end)
+{
+	auto inside = [&](int x) { const Fixed value = start + x * step; return value >= lo && value < hi; };
+	if (step == 0) {
+		if (!inside(0))
+			end = begin;
+		return;
+	}
+
+	//the exact bounds are found from the rounded ones, moving at most a pixel or two
+	double first = (double)(lo - start) / step, last = (double)(hi - start) / step;
+	if (step < 0)
+		std::swap(first, last);
+	int new_begin = (int)std::min(std::max(ceil(first), (double)begin), (double)end);
+	int new_end = (int)std::min(std::max(ceil(last), (double)new_begin), (double)end);
+	while (new_begin < new_end && !inside(new_begin)) ++new_begin;
+	while (new_begin > begin && inside(new_begin - 1)) --new_begin;
+	while (new_end > new_begin && !inside(new_end - 1)) --new_end;
+	while (new_end < end && inside(new_end)) ++new_end;
+	begin = new_begin;
+	end = std::max(new_begin, new_end);
+}
+
+// Bilinear mix of 4 values, fx and fy are the fractions of the sample point in 32 bit fixed point
+static inline unsigned char mixChannel(unsigned char c00, unsigned char c10, unsigned char c01, unsigned char c11, unsigned int fx, unsigned int fy)
+{
+	const unsigned int wx = fx >> 24, wy = fy >> 24;
+	const unsigned int top = c00 * (256 - wx) + c10 * wx;
+	const unsigned int bottom = c01 * (256 - wx) + c11 * wx;
+	return (unsigned char)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+}
+
+static inline unsigned short mixChannel(unsigned short c00, unsigned short c10, unsigned short c01, unsigned short c11, unsigned int fx, unsigned int fy)
+{
+	//65535 * 256 * 256 still fits in 32 bits
+	const unsigned int wx = fx >> 24, wy = fy >> 24;
+	const unsigned int top = c00 * (256 - wx) + c10 * wx;
+	const unsigned int bottom = c01 * (256 - wx) + c11 * wx;
+	return (unsigned short)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+}
+
+static inline float mixChannel(float c00, float c10, float c01, float c11, unsigned int fx, unsigned int fy)
+{
+	const float wx = (float)(fx / FIXED_ONE), wy = (float)(fy / FIXED_ONE);
+	const float top = c00 + (c10 - c00) * wx;
+	const float bottom = c01 + (c11 - c01) * wx;
+	return top + (bottom - top) * wy;
+}
+
+template <typename PixelT>
+static inline PixelT mixPixel(const PixelT& p00, const PixelT& p10, const PixelT& p01, const PixelT& p11, unsigned int fx, unsigned int fy)
+{
+	typedef PixelTraits<PixelT> Traits;
+	PixelT out;
+	for (unsigned int c = 0; c < Traits::color_channels + (Traits::has_alpha ? 1 : 0); ++c) //alpha is mixed too
+		out.v[c] = mixChannel(p00.v[c], p10.v[c], p01.v[c], p11.v[c], fx, fy);
+	return out;
+}
+
+template <typename PixelT>
+void warpAffine(const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst, const AffineTransform& transform,
+	WarpFilter filter, WarpEdge edge, const PixelT& border)
+{
+	if (src.isEmpty() || dst.isEmpty() || transform.determinant() == 0)
+		return;
+
+	const AffineTransform inverse = transform.inverse();
+	const bool bilinear = filter == WARP_BILINEAR;
+
+	//bilinear samples start half a pixel up and left, so the integer part is the top-left pixel of the four
+	const double shift = bilinear ? 0.5 : 0.0;
+	const Fixed step_u = toFixed(inverse.m[0], 4096), step_v = toFixed(inverse.m[3], 4096);
+
+	//region where every pixel read is inside the source
+	const Fixed max_u = (Fixed)(src.width - (bilinear ? 1 : 0)) << 32;
+	const Fixed max_v = (Fixed)(src.height - (bilinear ? 1 : 0)) << 32;
+	const Fixed half = (Fixed)1 << 31;
+
+	//source pixel at (x,y), following the edge mode outside the source
+	auto fetch = [&](int x, int y, PixelT& c) {
+		if (x >= 0 && y >= 0 && x < (int)src.width && y < (int)src.height)
+			c = src.getPixel(x, y);
+		else if (edge == WARP_EDGE_BORDER)
+			c = border;
+		else
+			c = src.getPixel(std::min(std::max(x, 0), (int)src.width - 1), std::min(std::max(y, 0), (int)src.height - 1));
+	};
+	auto sampleOutside = [&](Fixed u, Fixed v, PixelT& out) {
+		if (edge == WARP_EDGE_KEEP) {
+			//kept when the pixel centre is outside, clamped otherwise
+			const int x = fixedFloor(u + (bilinear ? half : 0)), y = fixedFloor(v + (bilinear ? half : 0));
+			if (x < 0 || y < 0 || x >= (int)src.width || y >= (int)src.height)
+				return;
+		}
+		const int x = fixedFloor(u), y = fixedFloor(v);
+		if (!bilinear) {
+			fetch(x, y, out);
+			return;
+		}
+		PixelT p00, p10, p01, p11;
+		fetch(x, y, p00); fetch(x + 1, y, p10);
+		fetch(x, y + 1, p01); fetch(x + 1, y + 1, p11);
+		out = mixPixel(p00, p10, p01, p11, fixedFraction(u), fixedFraction(v));
+	};
+
+	parallelForRows(dst.height, [&](unsigned int y_begin, unsigned int y_end) {
+		for (unsigned int y = y_begin; y < y_end; ++y)
+		{
+			//source position of the centre of the first pixel of the row
+			const Fixed start_u = toFixed(inverse.m[0] * 0.5 + inverse.m[1] * (y + 0.5) + inverse.m[2] - shift, 1 << 29);
+			const Fixed start_v = toFixed(inverse.m[3] * 0.5 + inverse.m[4] * (y + 0.5) + inverse.m[5] - shift, 1 << 29);
+
+			int begin = 0, end = dst.width;
+			clipSpan(start_u, step_u, 0, max_u, begin, end);
+			clipSpan(start_v, step_v, 0, max_v, begin, end);
+
+			PixelT* out = dst.getRow(y);
+			for (int x = 0; x < begin; ++x)
+				sampleOutside(start_u + x * step_u, start_v + x * step_v, out[x]);
+			for (int x = std::max(begin, end); x < (int)dst.width; ++x)
+				sampleOutside(start_u + x * step_u, start_v + x * step_v, out[x]);
+
+			//inside span, no checks
+			Fixed u = start_u + begin * step_u, v = start_v + begin * step_v;
+			if (!bilinear)
+				for (int x = begin; x < end; ++x, u += step_u, v += step_v)
+					out[x] = src.getRow(fixedFloor(v))[fixedFloor(u)];
+			else
+				for (int x = begin; x < end; ++x, u += step_u, v += step_v)
+				{
+					const PixelT* row = src.getRow(fixedFloor(v)) + fixedFloor(u);
+					const PixelT* next = row + src.stride;
+					out[x] = mixPixel(row[0], row[1], next[0], next[1], fixedFraction(u), fixedFraction(v));
+				}
+		}
+	});
+}
+
+// Pixel types the warp can be instantiated with
+template void warpAffine(const ImageViewT<ColorGray8>&, const ImageViewT<ColorGray8>&, const AffineTransform&, WarpFilter, WarpEdge, const ColorGray8&);
+template void warpAffine(const ImageViewT<Color>&, const ImageViewT<Color>&, const AffineTransform&, WarpFilter, WarpEdge, const Color&);
+template void warpAffine(const ImageViewT<ColorRGBA>&, const ImageViewT<ColorRGBA>&, const AffineTransform&, WarpFilter, WarpEdge, const ColorRGBA&);
+template void warpAffine(const ImageViewT<ColorRGB16>&, const ImageViewT<ColorRGB16>&, const AffineTransform&, WarpFilter, WarpEdge, const ColorRGB16&);
+template void warpAffine(const ImageViewT<ColorRGBF32>&, const ImageViewT<ColorRGBF32>&, const AffineTransform&, WarpFilter, WarpEdge, const ColorRGBF32&);
@@ -0,0 +1,57 @@
+/*  warp.h
+	Affine warps of images: every destination pixel takes the source pixel its centre maps to.
+	The transform is inverted once, and the source position then moves by a constant step along every row,
+	kept in 32.32 fixed point so every pixel costs an addition instead of a matrix product.
+	Every row is split into the span whose samples are all inside the source, copied without any check,
+	and the pixels left on both sides, which follow the edge mode.
+*/
+
+#ifndef WARP_H
+#define WARP_H
+
+#include "image.h"
+
+//how the source is sampled
+enum WarpFilter
+{
+	WARP_NEAREST = 0, //pixel under the sample point
+	WARP_BILINEAR //mix of the 4 pixels around it
+};
+
+//what the destination gets where the sample point falls outside the source
+enum WarpEdge
+{
+	WARP_EDGE_CLAMP = 0, //the nearest border pixel
+	WARP_EDGE_BORDER, //a given color
+	WARP_EDGE_KEEP //the destination is left as it was
+};
+
+//2x3 matrix: (x,y) goes to (m[0] * x + m[1] * y + m[2], m[3] * x + m[4] * y + m[5])
+class AffineTransform
+{
+public:
+	double m[6];
+
+	AffineTransform() { m[0] = 1; m[1] = 0; m[2] = 0; m[3] = 0; m[4] = 1; m[5] = 0; } //identity
+	AffineTransform(double a, double b, double tx, double c, double d, double ty) { m[0] = a; m[1] = b; m[2] = tx; m[3] = c; m[4] = d; m[5] = ty; }
+
+	static AffineTransform translation(double tx, double ty) { return AffineTransform(1, 0, tx, 0, 1, ty); }
+	static AffineTransform scaling(double sx, double sy) { return AffineTransform(sx, 0, 0, 0, sy, 0); }
+	static AffineTransform rotation(double angle) { return AffineTransform(cos(angle), -sin(angle), 0, sin(angle), cos(angle), 0); } //around the origin
+
+	double determinant() const { return m[0] * m[4] - m[1] * m[3]; }
+	AffineTransform inverse() const; //only valid when the determinant is not 0
+
+	// Transform that applies other first and then this one
+	AffineTransform operator * (const AffineTransform& other) const;
+
+	Vector2 transformPoint(float x, float y) const { return Vector2((float)(m[0] * x + m[1] * y + m[2]), (float)(m[3] * x + m[4] * y + m[5])); }
+};
+
+// Draws src into dst through transform (source coordinates to destination ones), both views must not overlap
+// Transforms that collapse the image (determinant 0) leave dst untouched
+template <typename PixelT>
+void warpAffine(const ImageViewT<PixelT>& src, const ImageViewT<PixelT>& dst, const AffineTransform& transform,
+	WarpFilter filter = WARP_BILINEAR, WarpEdge edge = WARP_EDGE_CLAMP, const PixelT& border = PixelT());
+
+#endif
@@ -5,18 +5,68 @@
 	 + It also contains the mainloop
 	 + This is the lowest level, here we access the system to create the opengl Context
 	 + It takes all the events from SDL and redirect them to the game
+	 + While nothing moves the loop sleeps until the next event, --busy draws every frame anyway
+	 + --pipelined renders the next frame on another thread while the last one is shown (during the animation)
+	 + --fps N caps the frames per second (60 by default, 0 is no cap), update always runs 60 steps per second
+	 + --selftest checks that the vectorized pixel kernels give the same bytes as the scalar ones and exits (0 if they do)
+	 + With --headless the app runs without a window (see headless.h):
+	     --headless [--frames N] [--dt seconds] [--dump path/prefix] [--press KEY[@frame]]...
+	   --press presses a key (by its SDL name: P, Space, Left...) in the events of a frame (0 by default)
+	   and releases it in the next one
 */
 
 #include "includes.h"
 #include "application.h"
+#include "simd.h"
+#include <string.h>
+#include <stdlib.h>
  
 
 int main(int argc, char **argv)
 {
+	bool headless = false, busy = false, pipelined = false;
+	double fps = 60;
+	HeadlessSettings settings;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--selftest") == 0) return testPixelKernels() ? 0 : 1;
+		else if (strcmp(argv[i], "--headless") == 0) headless = true;
+		else if (strcmp(argv[i], "--busy") == 0) busy = true;
+		else if (strcmp(argv[i], "--pipelined") == 0) pipelined = true;
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) fps = atof(argv[++i]);
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) settings.frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc) settings.frame_time = atof(argv[++i]);
+		else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) settings.dump_path = argv[++i];
+		else if (strcmp(argv[i], "--press") == 0 && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			unsigned int frame = 0;
+			const size_t at = name.find('@');
+			if (at != std::string::npos) {
+				frame = atoi(name.c_str() + at + 1);
+				name = name.substr(0, at);
+			}
+			const SDL_Scancode code = SDL_GetScancodeFromName(name.c_str());
+			if (code == SDL_SCANCODE_UNKNOWN) {
+				std::cerr << "Unknown key: " << name << std::endl;
+				return 1;
+			}
+			HeadlessKey press = { frame, code, true }, release = { frame + 1, code, false };
+			settings.keys.push_back(press);
+			settings.keys.push_back(release);
+		}
+	}
+
 	//launch the app (app is a global variable)
-	Application* app = new Application( "My app", 1680, 1080);
+	Application* app = new Application( "My app", 1680, 1080, headless);
+	app->wait_when_idle = !busy;
+	app->pipelined = pipelined;
+	app->scheduler.setFrameRate(fps);
 	app->init();
-	app->start();
+	if (headless)
+		app->startHeadless(settings);
+	else
+		app->start();
 
 	return 0;
 }